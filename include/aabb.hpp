@@ -0,0 +1,9 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+struct AABB
+{
+  glm::vec3 position;
+  glm::vec3 dimension;
+};
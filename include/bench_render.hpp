@@ -0,0 +1,19 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+struct BenchRenderOptions
+{
+  unsigned width  = 1280;
+  unsigned height = 720;
+  unsigned frames = 600;
+
+  // If set, a checksum of every rendered frame is written to this file, one
+  // line per frame, so that output can be compared between builds.
+  std::optional<std::string> checksums;
+};
+
+// Render a scripted camera flight through a freshly generated world into an
+// offscreen framebuffer and report frame time statistics.
+int bench_render(const BenchRenderOptions& options);
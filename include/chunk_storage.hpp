@@ -0,0 +1,20 @@
+#pragma once
+
+#include <world.hpp>
+
+#include <string>
+#include <string_view>
+
+// Chunks are stored one file per chunk under {world}/chunks, as a small
+// header followed by the raw blocks.
+std::string chunk_path(std::string_view world_path, glm::ivec2 chunk_index);
+
+bool chunk_exists(std::string_view world_path, glm::ivec2 chunk_index);
+
+// Throws std::runtime_error on failure. The chunk is written to a temporary
+// file first and renamed into place, so a chunk on disk is always complete.
+void save_chunk(std::string_view world_path, glm::ivec2 chunk_index, const Chunk& chunk);
+
+// Returns false if the chunk is missing, or was written by an incompatible
+// version.
+bool load_chunk(std::string_view world_path, glm::ivec2 chunk_index, Chunk& chunk);
@@ -5,6 +5,7 @@
 #include <graphics/font.hpp>
 
 #include <world.hpp>
+#include <light_manager.hpp>
 
 class DebugRenderer
 {
@@ -20,7 +21,7 @@ public:
 
 public:
   void update(float dt);
-  void render(glm::vec2 viewport, const World& world, graphics::UIRenderer& ui_renderer);
+  void render(glm::vec2 viewport, const World& world, const LightManager& light_manager, graphics::UIRenderer& ui_renderer);
 
 private:
   void render_line(glm::vec2 viewport, size_t n, const std::string& line, graphics::UIRenderer& ui_renderer);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <noise.hpp>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace YAML { class Node; }
+
+// Scalar field over the world, compiled from a tree of operations described in
+// YAML. Terrain generated from it is solid wherever it is positive.
+//
+// Every node is a map with a single key naming the operation:
+//
+//   constant: 64.0
+//   x: {}  y: {}  z: {}                    world coordinates
+//   noise2: { seed, frequency, amplitude, lacunarity, persistence, octaves }
+//   noise3: { seed, frequency, amplitude, lacunarity, persistence, octaves }
+//   add: [a, b, ...]  mul: [a, b, ...]  min: [a, b, ...]  max: [a, b, ...]
+//   sub: [a, b]
+//   neg: a  abs: a
+//   clamp: { value: a, min: 0.0, max: 1.0 }
+//   lerp: { t: a, from: b, to: c }         e.g. to blend between biomes
+//
+// noise2 only varies over x and y, and noise3 over all three axes. The seed of
+// a noise node is mixed with the world seed, so that the same noise can be
+// reused with different seeds.
+//
+// For example, rolling hills with overhangs:
+//
+//   add:
+//     - sub: [{ constant: 64.0 }, { z: {} }]
+//     - noise2: { seed: 0, frequency: 0.01, amplitude: 24.0, lacunarity: 2.0, persistence: 0.5, octaves: 4 }
+//     - noise3: { seed: 1, frequency: 0.04, amplitude: 12.0, lacunarity: 2.0, persistence: 0.5, octaves: 2 }
+//
+// At load time the tree is constant folded and flattened into a list of
+// instructions over registers, each holding a whole batch of samples, so that
+// evaluation is a handful of tight loops rather than a tree walk per sample.
+class DensityFunction
+{
+public:
+  // Throws std::runtime_error if the description is invalid
+  static DensityFunction compile(const YAML::Node& node, size_t seed, NoiseVersion version);
+
+public:
+  // Evaluate over a regular grid of samples at origin + index * step, with
+  // index < size, writing the result for index (x, y, z) into
+  // out[(z * size.y + y) * size.x + x].
+  void evaluate(glm::vec3 origin, glm::vec3 step, glm::uvec3 size, float *out) const;
+
+  size_t instruction_count() const { return m_instructions.size(); }
+
+private:
+  enum class Op
+  {
+    CONSTANT,
+    X, Y, Z,
+    NOISE2, NOISE3,
+    ADD, SUB, MUL, MIN, MAX,
+    NEG, ABS,
+    CLAMP,
+    LERP,
+  };
+
+  struct Instruction
+  {
+    Op       op;
+    unsigned dst;
+    unsigned src[3];
+
+    float       value;
+    float       min;
+    float       max;
+    size_t      seed;
+    NoiseConfig noise;
+  };
+
+  struct Node;
+
+  static Node     parse(const YAML::Node& yaml, size_t seed, NoiseVersion version);
+  static void     fold(Node& node);
+  static unsigned emit(const Node& node, std::vector<Instruction>& instructions, unsigned& register_count);
+
+private:
+  std::vector<Instruction> m_instructions;
+  unsigned                 m_register_count;
+  unsigned                 m_result;
+};
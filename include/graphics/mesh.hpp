@@ -64,7 +64,9 @@ namespace graphics
   private:
     IndexType     m_index_type;
     PrimitiveType m_primitive_type;
+    size_t        m_stride;
     size_t        m_element_count;
+    size_t        m_vertex_count;
 
     GLuint m_vao;
     GLuint m_ebo;
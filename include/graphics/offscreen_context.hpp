@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+
+#include <vector>
+
+#include <cstdint>
+
+namespace graphics
+{
+  // OpenGL context without any window, rendering into a framebuffer object.
+  //
+  // This uses EGL on the surfaceless platform where available, which works
+  // without any display server or GPU, e.g. on Mesa's llvmpipe.
+  class OffscreenContext
+  {
+  public:
+    OffscreenContext(unsigned width, unsigned height);
+    ~OffscreenContext();
+
+  public:
+    void get_framebuffer_size(int& width, int& height);
+    void read_pixels(std::vector<std::uint8_t>& pixels);
+
+  private:
+    unsigned m_width;
+    unsigned m_height;
+
+    EGLDisplay m_display;
+    EGLContext m_context;
+
+    GLuint m_fbo;
+    GLuint m_color_rbo;
+    GLuint m_depth_rbo;
+  };
+}
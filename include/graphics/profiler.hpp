@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace graphics
+{
+  enum class Pass
+  {
+    CHUNK,
+    ENTITY,
+    WIREFRAME,
+    UI,
+    COUNT,
+  };
+
+  const char *pass_name(Pass pass);
+
+  struct RenderCounters
+  {
+    std::size_t draw_calls;
+    std::size_t vertices;
+    std::size_t chunks_drawn;
+    std::size_t chunks_culled;
+    std::size_t bytes_uploaded;
+  };
+
+  // Per-frame GPU pass timings and draw counters.
+  //
+  // Pass timings are measured with timestamp queries. Each frame records its
+  // queries into one of FRAME_COUNT sets of query objects, and results are only
+  // read back when the same set is reused FRAME_COUNT frames later, at which
+  // point they are almost always available. If they are not, the sample is
+  // dropped rather than waited on, so that profiling never stalls the pipeline.
+  class Profiler
+  {
+  public:
+    static constexpr std::size_t FRAME_COUNT = 2;
+
+  public:
+    static Profiler& instance();
+
+    // Delete all query objects, which has to happen while the GL context is
+    // still around, unlike the destruction of the profiler itself
+    void release();
+
+  public:
+    void begin_frame();
+
+    void begin(Pass pass);
+    void end(Pass pass);
+
+  public:
+    RenderCounters& counters() { return m_counters; }
+
+    const RenderCounters& last_counters() const { return m_last_counters; }
+    float                 pass_time(Pass pass) const { return m_pass_times[static_cast<std::size_t>(pass)]; }
+
+    std::string dump() const;
+
+  private:
+    struct Frame
+    {
+      std::vector<GLuint> queries;
+      std::vector<Pass>   passes;
+      std::size_t         used;
+    };
+
+    void collect(Frame& frame);
+
+  private:
+    Frame       m_frames[FRAME_COUNT] = {};
+    std::size_t m_current             = 0;
+    std::size_t m_frame_number        = 0;
+
+    RenderCounters m_counters      = {};
+    RenderCounters m_last_counters = {};
+    float          m_pass_times[static_cast<std::size_t>(Pass::COUNT)] = {};
+  };
+}
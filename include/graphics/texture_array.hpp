@@ -5,13 +5,23 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 namespace graphics
 {
   struct TextureArray
   {
     public:
-      TextureArray(const std::vector<std::string>& filenames);
+      // Load textures from filenames, going through a baked cache at
+      // cache_filename. The cache contains the decoded RGBA bytes of all layers
+      // together with their mipmaps so that it can be uploaded directly. It is
+      // rebuilt if it is missing or stale.
+      static std::unique_ptr<TextureArray> load_from(const std::vector<std::string>& filenames, const std::string& cache_filename);
+
+    public:
+      // Bytes are expected to contain all layers of mipmap level 0, followed by
+      // all layers of mipmap level 1 and so on, in RGBA format.
+      TextureArray(const unsigned char *bytes, unsigned width, unsigned height, unsigned depth, unsigned levels);
       ~TextureArray();
 
     public:
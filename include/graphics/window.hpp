@@ -6,6 +6,10 @@
 
 namespace graphics
 {
+  // Common OpenGL state shared by every context we create. Must be called with
+  // the context current and OpenGL functions loaded.
+  void setup_gl_state();
+
   class Window
   {
   public:
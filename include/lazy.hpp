@@ -20,6 +20,7 @@ public:
     ThreadPool::instance().enqueue([state=m_state, f=std::move(f)](){
       ::new(&state->storage) T(f());
       state->done.store(true, std::memory_order_release);
+      state->done.notify_all();
     });
   }
 
@@ -2,19 +2,109 @@
 
 #include <world.hpp>
 
+#include <ring_buffer.hpp>
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+// Keeps light consistent with the blocks around it.
+//
+// Air with nothing but air above it is lit directly by the sky, and light
+// spreads from there into the rest of the air, one level dimmer per block.
+// Chunks that are not loaded yet count as fully bright.
+//
+// Whether a block is lit by the sky follows directly from the height of the
+// topmost solid block in its column, which each chunk keeps track of, so a
+// changed block updates everything below it in one go. Only the light spread
+// around from there goes through the flood fills.
+//
+// Changes are propagated with two flood fills. Light that may have come from
+// a changed block is first removed, following it outwards only for as long as
+// it keeps getting dimmer, and light is then spread back in from the edges of
+// the removed area and from anything that got brighter. Only blocks whose light
+// actually depends on the change are ever visited.
+//
+// Each flood fill runs in rounds over the chunks it has reached, and a chunk
+// only ever touches its own blocks. Light crossing a chunk border is posted to
+// the chunk on the other side, which picks it up in the next round, so that
+// all chunks with work left can be processed in parallel on the thread pool.
+//
+// Within a round, chunks closest to a player go first, and an update with a
+// time budget stops handing out chunks once it runs out, leaving the rest of
+// the work for the next update. Chunks with pending work must therefore stay
+// loaded until it is done.
+//
+// Chunks with light still settling are marked as generated, and as lit once
+// there is nothing left to do in them.
 class LightManager
 {
+public:
+  static constexpr std::chrono::milliseconds TICK_BUDGET = std::chrono::milliseconds(10);
+
 public:
   void invalidate(glm::ivec3 position);
+
+  // Have a chunk that was just loaded marked as lit once light has settled in
+  // it, even if none of its blocks have been invalidated
+  void invalidate(glm::ivec2 chunk_index);
+
+  // Make progress on updating light for as long as the budget allows, which
+  // is always at least one chunk if there is anything to do at all
+  void update(World& world, std::chrono::steady_clock::duration budget);
+
+  // Update light until there is nothing left to do
   void update(World& world);
 
+  // Number of blocks whose light is still waiting to be updated
+  size_t pending() const;
+
 private:
-  struct Invalidation
+  // Light level at a block, addressed by its index within a chunk
+  struct Node
   {
-    Block*       block;
-    std::uint8_t new_sky;
-    std::uint8_t new_light_level;
+    std::uint16_t index;
+    std::uint8_t  light_level;
   };
-  std::unordered_map<glm::ivec3, Invalidation> m_invalidations;
-};
 
+  static_assert(CHUNK_WIDTH * CHUNK_WIDTH * CHUNK_HEIGHT <= 65536, "Block index within a chunk must fit in 16 bits");
+
+  struct Region
+  {
+    Chunk*     chunk;
+    glm::ivec2 chunk_index;
+    Chunk*     neighbours[4]; // nullptr if not loaded
+
+    RingBuffer<Node>          removals;
+    RingBuffer<std::uint16_t> additions;
+
+    // Chunks whose mesh is affected by light changed so far, bit 0 for the
+    // chunk itself and bit i+1 for neighbours[i]
+    std::uint8_t updates = 0;
+
+    // Light that crossed over from neighbouring chunks, and light crossing
+    // over to neighbouring chunks, separately for each phase
+    std::vector<Node> inboxes[2];
+    std::vector<Node> outboxes[2][4];
+
+    float priority; // Distance to the closest player
+  };
+
+  enum class Phase { REMOVAL, ADDITION };
+
+  Region& region(World& world, glm::ivec2 chunk_index, Chunk& chunk);
+  static void find_neighbours(World& world, Region& region);
+  void run(World& world, std::chrono::steady_clock::time_point deadline);
+
+  static void mark_updated(Region& region, glm::ivec3 position);
+  static void remove(Region& region, glm::ivec3 position, Block& block);
+  static void update_sky_height(Region& region, glm::ivec3 position);
+
+  static void process_removals(Region& region);
+  static void process_additions(Region& region);
+
+private:
+  std::vector<glm::ivec3>                m_invalidations;
+  std::vector<glm::ivec2>                m_chunk_invalidations;
+  std::unordered_map<glm::ivec2, Region> m_regions;
+};
@@ -4,8 +4,22 @@
 
 #include <glm/glm.hpp>
 
+namespace YAML { class Node; }
+
+enum class NoiseVersion : unsigned
+{
+  // Gradients drawn from a std::mt19937 seeded for every lattice corner. Slow,
+  // but kept so that existing worlds keep generating identically.
+  LEGACY = 1,
+
+  // Gradients looked up from a fixed table through an integer hash.
+  HASHED = 2,
+};
+
 struct NoiseConfig
 {
+  NoiseVersion version;
+
   float frequency;
   float amplitude;
   float lacunarity;
@@ -13,8 +27,25 @@ struct NoiseConfig
   float octaves;
 };
 
+NoiseConfig load_noise_config(const YAML::Node& node, NoiseVersion version);
+
 template<glm::length_t L>
 float noise(size_t seed, glm::vec<L, float> position, NoiseConfig config)
 {
-  return perlin(seed, position, config.frequency, config.amplitude, config.lacunarity, config.persistence, config.octaves);
+  switch(config.version)
+  {
+  case NoiseVersion::LEGACY: return perlin       (seed, position, config.frequency, config.amplitude, config.lacunarity, config.persistence, config.octaves);
+  case NoiseVersion::HASHED: return perlin_hashed(seed, position, config.frequency, config.amplitude, config.lacunarity, config.persistence, config.octaves);
+  }
+  return 0.0f;
 }
+
+// Evaluate noise over a regular grid of samples at origin + index * step, with
+// index < size, writing the result for index (x, y[, z]) into
+// out[(z * size.y + y) * size.x + x].
+//
+// This is equivalent to calling noise() for every sample, but gradients of each
+// lattice corner are only computed once and shared between all samples around
+// it, and samples are evaluated several at a time with SIMD where available.
+void noise_grid(size_t seed, glm::vec2 origin, glm::vec2 step, glm::uvec2 size, NoiseConfig config, float *out);
+void noise_grid(size_t seed, glm::vec3 origin, glm::vec3 step, glm::uvec3 size, NoiseConfig config, float *out);
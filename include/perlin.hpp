@@ -6,6 +6,9 @@
 #include <glm/gtx/norm.hpp>
 
 #include <random>
+#include <numbers>
+
+#include <cstdint>
 
 namespace details
 {
@@ -61,6 +64,101 @@ namespace details
       + 10 * std::pow(t, 3);
     return a + (b - a) * factor;
   }
+
+  /**********
+   * Hashed *
+   **********/
+  static inline std::uint32_t hash_seed(size_t seed)
+  {
+    // splitmix64 finalizer, folded to 32 bits
+    std::uint64_t z = seed + 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    z = z ^ (z >> 31);
+    return static_cast<std::uint32_t>(z ^ (z >> 32));
+  }
+
+  template<glm::length_t L>
+  static inline std::uint32_t hash_node(std::uint32_t seed, glm::vec<L, int> node)
+  {
+    static constexpr std::uint32_t PRIMES[] = { 0x9e3779b1, 0x85ebca77, 0xc2b2ae3d, 0x27d4eb2f };
+    static_assert(L <= std::size(PRIMES));
+
+    std::uint32_t h = seed;
+    for(glm::length_t i=0; i<L; ++i)
+      h ^= static_cast<std::uint32_t>(node[i]) * PRIMES[i];
+
+    // murmur3 finalizer
+    h ^= h >> 16; h *= 0x85ebca6b;
+    h ^= h >> 13; h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+  }
+
+  template<glm::length_t L> struct GradientTable;
+
+  template<> struct GradientTable<2>
+  {
+    static constexpr unsigned SIZE = 16;
+    glm::vec2 gradients[SIZE];
+
+    GradientTable()
+    {
+      for(unsigned i=0; i<SIZE; ++i)
+      {
+        float angle = 2.0f * std::numbers::pi_v<float> * i / SIZE;
+        gradients[i] = glm::vec2(std::cos(angle), std::sin(angle));
+      }
+    }
+  };
+
+  template<> struct GradientTable<3>
+  {
+    // Edges of a cube as in Ken Perlin's "Improving Noise", padded to 16
+    // entries, normalized to match the unit length of legacy gradients.
+    static constexpr unsigned SIZE = 16;
+    glm::vec3 gradients[SIZE];
+
+    GradientTable()
+    {
+      const glm::vec3 edges[SIZE] = {
+        { 1,  1,  0}, {-1,  1,  0}, { 1, -1,  0}, {-1, -1,  0},
+        { 1,  0,  1}, {-1,  0,  1}, { 1,  0, -1}, {-1,  0, -1},
+        { 0,  1,  1}, { 0, -1,  1}, { 0,  1, -1}, { 0, -1, -1},
+        { 1,  1,  0}, {-1,  1,  0}, { 0, -1,  1}, { 0, -1, -1},
+      };
+      for(unsigned i=0; i<SIZE; ++i)
+        gradients[i] = glm::normalize(edges[i]);
+    }
+  };
+
+  template<glm::length_t L>
+  static inline glm::vec<L, float> perlin_gradient_hashed(std::uint32_t seed, glm::vec<L, int> node)
+  {
+    static const GradientTable<L> table;
+    return table.gradients[hash_node(seed, node) % GradientTable<L>::SIZE];
+  }
+
+  static inline float perlin_fade(float t)
+  {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+  }
+
+  template<glm::length_t L, glm::length_t D>
+  static inline float perlin_hashed_impl(std::uint32_t seed, glm::vec<L, float> position, glm::vec<L, int> node) requires(D == L)
+  {
+    glm::vec<L, float> gradient = perlin_gradient_hashed(seed, node);
+    glm::vec<L, float> offset   = position - glm::vec<L, float>(node);
+    return glm::dot(gradient, offset);
+  }
+
+  template<glm::length_t L, glm::length_t D>
+  static inline float perlin_hashed_impl(std::uint32_t seed, glm::vec<L, float> position, glm::vec<L, int> node) requires(0 <= D && D < L)
+  {
+    float a = perlin_hashed_impl<L, D+1>(seed, position, node);
+    float b = perlin_hashed_impl<L, D+1>(seed, position, node + unit_vector<L, D>());
+    return a + (b - a) * perlin_fade(position[D] - node[D]);
+  }
 }
 
 template<glm::length_t L>
@@ -83,4 +181,28 @@ float perlin(size_t seed, glm::vec<L, float> position, float frequency, float am
   return value;
 }
 
+// Same as above, but with gradients looked up from a fixed table through an
+// integer hash of the lattice corner instead of being drawn from a freshly
+// seeded std::mt19937 for every corner. The two produce different noise for the
+// same seed.
+template<glm::length_t L>
+float perlin_hashed(size_t seed, glm::vec<L, float> position)
+{
+  glm::vec<L, int> node = glm::floor(position);
+  return details::perlin_hashed_impl<L, 0>(details::hash_seed(seed), position, node);
+}
+
+template<glm::length_t L>
+float perlin_hashed(size_t seed, glm::vec<L, float> position, float frequency, float amplitude, float lacunarity, float persistence, unsigned octaves)
+{
+  float value = 0.0f;
+  for(unsigned i=0; i<octaves; ++i)
+  {
+    value += perlin_hashed(seed + i, position * frequency) * amplitude;
+    frequency *= lacunarity;
+    amplitude *= persistence;
+  }
+  return value;
+}
+
 #endif // PERLIN_HPP
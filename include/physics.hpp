@@ -2,4 +2,14 @@
 
 #include <world.hpp>
 
+#include <vector>
+
 void update_physics(World& world, float dt);
+
+// Wake up entities that may have been resting on or against the block at the
+// given position, which is about to change or just has
+void wake_entities(World& world, glm::ivec3 position);
+
+// Find entities whose bounding box comes within radius of center. Only entities
+// that were around for the last physics update are found.
+void query_entities(const World& world, glm::vec3 center, float radius, std::vector<size_t>& entity_ids);
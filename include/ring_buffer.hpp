@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include <assert.h>
+#include <stddef.h>
+
+// First in, first out queue over a single flat array that doubles in size when
+// full. Unlike std::deque, the same storage keeps being reused once it is large
+// enough, so a queue that is repeatedly filled and drained stops allocating.
+template<typename T>
+class RingBuffer
+{
+public:
+  bool   empty() const { return m_begin == m_end; }
+  size_t size()  const { return m_end - m_begin; }
+
+  void push(T value)
+  {
+    if(size() == m_capacity)
+      grow();
+
+    m_values[m_end++ & (m_capacity - 1)] = std::move(value);
+  }
+
+  T pop()
+  {
+    assert(!empty());
+    return std::move(m_values[m_begin++ & (m_capacity - 1)]);
+  }
+
+private:
+  void grow()
+  {
+    size_t capacity = m_capacity != 0 ? m_capacity * 2 : 256;
+
+    std::unique_ptr<T[]> values = std::make_unique<T[]>(capacity);
+    for(size_t i=0; i<size(); ++i)
+      values[i] = std::move(m_values[(m_begin + i) & (m_capacity - 1)]);
+
+    m_end      = size();
+    m_begin    = 0;
+    m_values   = std::move(values);
+    m_capacity = capacity;
+  }
+
+private:
+  std::unique_ptr<T[]> m_values;
+  size_t               m_capacity = 0; // Always a power of two
+  size_t               m_begin    = 0;
+  size_t               m_end      = 0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <aabb.hpp>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+// Uniform grid over a set of boxes, identified by their index within the set.
+//
+// Each box is filed under every cell it overlaps, so that finding the boxes
+// near a given box only takes looking at the cells it overlaps, rather than at
+// every box in the set. Boxes are kept until they are updated, so that moving
+// a few boxes around only costs as much as those boxes.
+class SpatialHash
+{
+public:
+  static constexpr float CELL_SIZE = 4.0f;
+
+public:
+  size_t size() const { return m_aabbs.size(); }
+
+  void clear();
+
+  // Add a box with the next index
+  void insert(const AABB& aabb);
+
+  // Move the box with the given index
+  void update(std::uint32_t index, const AABB& aabb);
+
+  // Call f with the index of every box overlapping the given box, touching
+  // included, exactly once each
+  template<typename F>
+  void query(const AABB& aabb, F f) const
+  {
+    glm::ivec3 min = cell_min(aabb);
+    glm::ivec3 max = cell_max(aabb);
+    for(int z = min.z; z <= max.z; ++z)
+      for(int y = min.y; y <= max.y; ++y)
+        for(int x = min.x; x <= max.x; ++x)
+        {
+          auto it = m_cells.find(glm::ivec3(x, y, z));
+          if(it == m_cells.end())
+            continue;
+
+          for(std::uint32_t index : it->second)
+          {
+            const AABB& other = m_aabbs[index];
+
+            // Boxes spanning several cells are only reported from the first
+            // cell they have in common with the query
+            if(glm::max(cell_min(other), min) != glm::ivec3(x, y, z))
+              continue;
+
+            if(glm::all(glm::lessThanEqual(aabb.position, other.position + other.dimension)) &&
+               glm::all(glm::lessThanEqual(other.position, aabb.position + aabb.dimension)))
+              f(index);
+          }
+        }
+  }
+
+private:
+  static glm::ivec3 cell_min(const AABB& aabb) { return glm::floor(aabb.position / CELL_SIZE); }
+  static glm::ivec3 cell_max(const AABB& aabb) { return glm::floor((aabb.position + aabb.dimension) / CELL_SIZE); }
+
+  void link(std::uint32_t index);
+  void unlink(std::uint32_t index);
+
+private:
+  std::vector<AABB>                                           m_aabbs;
+  std::unordered_map<glm::ivec3, std::vector<std::uint32_t>> m_cells; // Indices of boxes overlapping each cell
+};
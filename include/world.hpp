@@ -1,5 +1,7 @@
 #pragma once
 
+#include <aabb.hpp>
+#include <spatial_hash.hpp>
 #include <transform.hpp>
 
 #include <glm/glm.hpp>
@@ -14,16 +16,14 @@
 static constexpr int CHUNK_WIDTH  = 16;
 static constexpr int CHUNK_HEIGHT = 256;
 
+// Radius in chunks around players within which chunks are loaded and entities
+// are simulated
+static constexpr int CHUNK_LOAD_RADIUS = 4;
+
 static constexpr std::uint32_t BLOCK_ID_STONE = 0;
 static constexpr std::uint32_t BLOCK_ID_GRASS = 1;
 static constexpr std::uint32_t BLOCK_ID_NONE  = 2;
 
-struct AABB
-{
-  glm::vec3 position;
-  glm::vec3 dimension;
-};
-
 struct Entity
 {
   std::uint16_t id;
@@ -35,6 +35,19 @@ struct Entity
 
   bool collided;
   bool grounded;
+
+  // Sleeping entities are left alone by physics until woken up, see
+  // update_physics()
+  bool  sleeping;
+  float rest_time;
+
+  // Frozen entities are too far away from players to be moved at all, and are
+  // left alone by physics until one comes close, see update_physics()
+  bool frozen;
+
+  // Time that has passed since the entity was last moved by physics, which
+  // moves entities far away from players less often, see update_physics()
+  float pending_time;
 };
 
 struct Player
@@ -64,10 +77,25 @@ struct Block
   std::uint32_t destroy_level : 4;
 };
 
+// Chunks are only meshed once light in them and in all their loaded neighbours
+// has settled, since light still settling would have them meshed over and
+// over. Chunks are meshed again once a neighbour that was missing is loaded
+// and settled, as their faces towards it may now be hidden.
+enum class ChunkState : std::uint8_t
+{
+  GENERATED, // Blocks are in place, but light is still settling
+  LIT,       // Light is settled
+};
+
 struct Chunk
 {
   Block blocks[CHUNK_HEIGHT][CHUNK_WIDTH][CHUNK_WIDTH];
 
+  // Lowest z in each column from which on there is nothing but air, which is
+  // lit directly by the sky
+  std::uint16_t sky_heights[CHUNK_WIDTH][CHUNK_WIDTH];
+
+  ChunkState                             state;
   mutable bool                           mesh_invalidated;
 };
 
@@ -76,6 +104,16 @@ struct World
   std::unordered_map<glm::ivec2, Chunk> chunks;
   std::vector<Entity>                   entities;
   std::vector<Player>                   players;
+
+  // Space swept by each entity during the last physics update it was moved in,
+  // entities that are neither sleeping nor frozen, and frozen entities by the
+  // chunk they are in, see update_physics()
+  SpatialHash                                                entity_hash;
+  std::vector<std::uint32_t>                                 awake_entities;
+  std::unordered_map<glm::ivec2, std::vector<std::uint32_t>> frozen_entities;
+
+  // Number of physics updates so far
+  std::uint64_t physics_ticks = 0;
 };
 
 /**********
@@ -83,9 +121,12 @@ struct World
  **********/
 AABB entity_get_aabb(const Entity& entity);
 
-void entity_apply_impulse (Entity& entity, glm::vec3 force);
-void entity_apply_force   (Entity& entity, glm::vec3 force, float dt);
-void entity_apply_force   (Entity& entity, glm::vec3 force, float dt, float max);
+// Pushing an entity around wakes it up
+void entity_apply_impulse (World& world, size_t entity_id, glm::vec3 force);
+void entity_apply_force   (World& world, size_t entity_id, glm::vec3 force, float dt);
+void entity_apply_force   (World& world, size_t entity_id, glm::vec3 force, float dt, float max);
+
+void entity_wake(World& world, size_t entity_id);
 
 /******************
  * Block Accessor *
@@ -96,6 +137,16 @@ const Block* get_block(const Chunk& chunk, glm::ivec3 position);
       Block* get_block(      World& world, glm::ivec3 position);
 const Block* get_block(const World& world, glm::ivec3 position);
 
+/*******
+ * Sky *
+ *******/
+void compute_sky_heights(Chunk& chunk);
+
+/*********
+ * Chunk *
+ *********/
+bool is_meshable(const World& world, glm::ivec2 chunk_index);
+
 /**************************
  * Invalidate them ALL!!! *
  **************************/
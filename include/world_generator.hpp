@@ -6,8 +6,14 @@
 
 #include <noise.hpp>
 #include <lazy.hpp>
+#include <density_function.hpp>
 
+#include <atomic>
+#include <optional>
+#include <span>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 struct LayerGenerationConfig
 {
@@ -17,9 +23,21 @@ struct LayerGenerationConfig
   NoiseConfig height_noise;
 };
 
+// Terrain is solid wherever the density function is positive, and the topmost
+// surface_depth blocks of solid ground are made of surface_block_id instead.
+struct DensityGenerationConfig
+{
+  std::uint32_t block_id;
+  std::uint32_t surface_block_id;
+  unsigned      surface_depth;
+
+  DensityFunction function;
+};
+
 struct TerrainGenerationConfig
 {
-  std::vector<LayerGenerationConfig> layers;
+  std::vector<LayerGenerationConfig>     layers;
+  std::optional<DensityGenerationConfig> density; // Replaces layers if present
 };
 
 struct CavesGenerationConfig
@@ -40,29 +58,86 @@ struct CavesGenerationConfig
 struct WorldGenerationConfig
 {
   std::size_t             seed;
+  NoiseVersion            noise_version;
   TerrainGenerationConfig terrain;
   CavesGenerationConfig   caves;
 };
 
 WorldGenerationConfig load_world_generation_config(std::string_view path);
 
+// Generates chunks around every player on the thread pool.
+//
+// Missing chunks are ordered by distance to the nearest player, with chunks
+// behind a player counting as further away, and only a bounded number of jobs
+// is handed to the thread pool at a time. Priorities are recomputed on every
+// update, so that a moving player is never stuck behind work queued for where
+// they used to be, and chunks that fall out of range before being submitted
+// are never generated. The thread pool runs jobs in order and cannot cancel
+// them, so the bound is kept just high enough to keep every thread busy.
+//
+// Given the path of a world, chunks stored in it, such as by voxy-pregen, are
+// read back on the thread pool rather than generated again.
 class WorldGenerator
 {
 public:
-  static constexpr size_t CHUNK_LOAD_RADIUS = 4;
+  static constexpr unsigned MAX_JOBS_PER_THREAD = 2;
+  static constexpr float    VIEW_WEIGHT         = 1.0f;
+
+  // Comfortably above the (2 * (CHUNK_LOAD_RADIUS + r) + 1)^2 chunk infos a
+  // single player needs at once, where r is the reach of cave worms in chunks.
+  // The cache holds this many for every player, on top of those needed by
+  // chunks being generated.
+  static constexpr size_t CHUNK_INFOS_PER_PLAYER = 1024;
+
+  // Time spent in each phase of generation, in nanoseconds summed over all
+  // threads, and the amount of work done.
+  struct Statistics
+  {
+    std::atomic<std::uint64_t> height_maps;
+    std::atomic<std::uint64_t> worms;
+    std::atomic<std::uint64_t> fill;
+    std::atomic<std::uint64_t> carve;
+    std::atomic<std::uint64_t> light;
+    std::atomic<std::uint64_t> splice;
+
+    std::atomic<std::uint64_t> chunk_info_count;
+    std::atomic<std::uint64_t> chunk_count;
+  };
 
 public:
-  WorldGenerator(WorldGenerationConfig config);
+  WorldGenerator(WorldGenerationConfig config, std::optional<std::string> world_path = std::nullopt);
 
 public:
+  // Make progress on loading chunks around every player
   void update(World& world, LightManager& light_manager);
 
+  // Make progress on loading the given chunks, most important first
+  void update(World& world, LightManager& light_manager, std::span<const glm::ivec2> chunk_indices);
+
+  // Block until a job handed to the thread pool has finished, if there is any,
+  // for callers that have nothing better to do than wait for chunks
+  void wait();
+
+  const Statistics& statistics() const { return m_statistics; }
+
 private:
-  void try_load(World& world, LightManager& light_manager, glm::ivec2 chunk_index, int radius);
-  void try_load(World& world, LightManager& light_manager, glm::ivec2 chunk_index);
+  struct Request
+  {
+    glm::ivec2 chunk_index;
+    float      priority;
+  };
+
+  std::vector<glm::ivec2> collect_requests(const World& world) const;
+  bool try_submit(glm::ivec2 chunk_index);
+
+  int chunk_info_radius() const;
+  void evict_chunk_infos(size_t player_count);
 
 private:
-  WorldGenerationConfig m_config;
+  WorldGenerationConfig      m_config;
+  std::optional<std::string> m_world_path;
+  size_t                     m_max_jobs;
+  Statistics            m_statistics = {};
 
 private:
   struct HeightMap
@@ -83,14 +158,43 @@ private:
   struct ChunkInfo
   {
     std::vector<HeightMap> height_maps;
-    std::vector<Worm>      worms;
+
+    // Nodes of worms starting in this chunk, binned by the chunks they overlap
+    std::unordered_map<glm::ivec2, std::vector<Worm::Node>> worm_nodes;
+  };
+
+  struct CachedChunkInfo
+  {
+    template<typename F>
+    CachedChunkInfo(F f) : info(std::move(f)) {}
+
+    Lazy<ChunkInfo> info;
+    std::uint64_t   last_used = 0;
   };
 
 private:
   template<typename Prng> static std::vector<HeightMap> generate_height_maps(Prng& prng, const TerrainGenerationConfig& config, glm::ivec2 chunk_index);
   template<typename Prng> static std::vector<Worm> generate_worms(Prng& prng, const CavesGenerationConfig& config, glm::ivec2 chunk_index);
-  template<typename Prng> static ChunkInfo generate_chunk_info(Prng& prng_global, Prng& prng_local, const WorldGenerationConfig& config, glm::ivec2 chunk_index);
+  template<typename Prng> static ChunkInfo generate_chunk_info(Prng& prng_global, Prng& prng_local, const WorldGenerationConfig& config, glm::ivec2 chunk_index, Statistics& statistics);
 
 private:
-  std::unordered_map<glm::ivec2, Lazy<ChunkInfo>> m_chunk_infos;
+  struct GeneratedChunk
+  {
+    std::unordered_map<glm::ivec2, Chunk>::node_type node;
+    std::vector<glm::ivec3>                          invalidations; // Blocks on the border whose light depends on neighbouring chunks
+  };
+
+  static void generate_layered_terrain(Chunk& chunk, const ChunkInfo& chunk_info, const TerrainGenerationConfig& config);
+  static void generate_density_terrain(Chunk& chunk, glm::ivec2 chunk_index, const DensityGenerationConfig& config);
+  static GeneratedChunk load_stored_chunk(const std::string& world_path, glm::ivec2 chunk_index);
+  static GeneratedChunk generate_chunk(const WorldGenerationConfig& config, glm::ivec2 chunk_index, int radius, const std::vector<const ChunkInfo*>& chunk_infos, Statistics& statistics);
+  static void splice(World& world, LightManager& light_manager, glm::ivec2 chunk_index, GeneratedChunk& generated_chunk);
+
+private:
+  std::uint64_t m_update_count = 0;
+
+  std::unordered_map<glm::ivec2, CachedChunkInfo>      m_chunk_infos;
+  std::vector<glm::ivec2>                              m_chunk_infos_in_flight;
+  std::unordered_set<glm::ivec2>                       m_unreadable_chunks; // Stored chunks that failed to load and are generated instead
+  std::unordered_map<glm::ivec2, Lazy<GeneratedChunk>> m_generated_chunks; // Must be destroyed first as they refer to chunk infos
 };
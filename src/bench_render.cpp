@@ -0,0 +1,176 @@
+#include <bench_render.hpp>
+
+#include <world.hpp>
+#include <world_generator.hpp>
+#include <light_manager.hpp>
+
+#include <graphics/camera.hpp>
+#include <graphics/offscreen_context.hpp>
+#include <graphics/profiler.hpp>
+#include <graphics/wireframe_renderer.hpp>
+
+#include <world_renderer.hpp>
+#include <player_ui.hpp>
+
+#include <resource_pack.hpp>
+
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <experimental/scope>
+#include <fstream>
+#include <numbers>
+#include <stdexcept>
+
+static constexpr float PATH_RADIUS   = 40.0f;
+static constexpr float PATH_HEIGHT   = 90.0f;
+static constexpr float PATH_PITCH    = -25.0f;
+static constexpr int   PATH_SEGMENTS = 32;
+
+static constexpr unsigned WARMUP_FRAMES = 4;
+
+// Camera flies a full circle around the spawn over the course of the benchmark
+static Transform camera_path(float t)
+{
+  float angle = 2.0f * std::numbers::pi_v<float> * t;
+
+  Transform transform;
+  transform.position = glm::vec3(PATH_RADIUS * std::cos(angle), PATH_RADIUS * std::sin(angle), PATH_HEIGHT);
+  transform.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  return transform.rotate(glm::vec3(0.0f, PATH_PITCH, glm::degrees(angle)));
+}
+
+static bool is_loaded(const World& world, glm::ivec2 center, int radius)
+{
+  for(int dy = -radius; dy <= radius; ++dy)
+    for(int dx = -radius; dx <= radius; ++dx)
+      if(dx * dx + dy * dy <= radius * radius)
+        if(!world.chunks.contains(center + glm::ivec2(dx, dy)))
+          return false;
+  return true;
+}
+
+static std::uint64_t checksum(const std::vector<std::uint8_t>& pixels)
+{
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for(std::uint8_t pixel : pixels)
+  {
+    hash ^= pixel;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+static float percentile(const std::vector<float>& sorted, float p)
+{
+  size_t index = std::clamp<size_t>(std::ceil(p * sorted.size()), 1, sorted.size()) - 1;
+  return sorted[index];
+}
+
+int bench_render(const BenchRenderOptions& options)
+{
+  if(options.frames == 0 || options.width == 0 || options.height == 0)
+    throw std::runtime_error("Render benchmark needs at least one frame and a non-empty framebuffer");
+
+  graphics::OffscreenContext  context(options.width, options.height);
+  graphics::Camera            camera;
+  graphics::WireframeRenderer wireframe_renderer;
+
+  World world = load_world("world");
+
+  WorldGenerator world_generator(load_world_generation_config("world"));
+  LightManager   light_manager;
+
+  WorldRenderer world_renderer(load_resource_pack("resource_pack"));
+
+  Player& player        = world.players.front();
+  Entity& player_entity = world.entities.at(player.entity_id);
+
+  // 1: Generate everything visible along the path up front, so that every run
+  //    renders exactly the same world regardless of worker scheduling.
+  auto generation_begin = std::chrono::steady_clock::now();
+  for(int i=0; i<PATH_SEGMENTS; ++i)
+  {
+    player_entity.transform = camera_path(static_cast<float>(i) / PATH_SEGMENTS);
+
+    glm::ivec2 center = glm::floor(glm::vec2(player_entity.transform.position) / static_cast<float>(CHUNK_WIDTH));
+    while(!is_loaded(world, center, CHUNK_LOAD_RADIUS))
+    {
+      world_generator.wait();
+      world_generator.update(world, light_manager);
+      light_manager.update(world);
+    }
+  }
+  auto generation_end = std::chrono::steady_clock::now();
+  spdlog::info("Generated {} chunks in {:.2f} s", world.chunks.size(), std::chrono::duration<float>(generation_end - generation_begin).count());
+
+  // 2: Fly through the world
+  std::optional<std::ofstream> checksums;
+  if(options.checksums)
+    checksums.emplace(*options.checksums);
+
+  graphics::Profiler& profiler = graphics::Profiler::instance();
+  std::experimental::scope_exit profiler_exit([&profiler]() { profiler.release(); });
+
+  std::vector<float>        frame_times;
+  std::vector<std::uint8_t> pixels;
+  for(unsigned i=0; i<WARMUP_FRAMES + options.frames; ++i)
+  {
+    auto frame_begin = std::chrono::steady_clock::now();
+
+    profiler.begin_frame();
+
+    unsigned frame = i >= WARMUP_FRAMES ? i - WARMUP_FRAMES : 0;
+    player_entity.transform = camera_path(static_cast<float>(frame) / options.frames);
+
+    camera.transform = player_entity.transform;
+    camera.transform.position.z += player_entity.eye;
+    camera.aspect = static_cast<float>(options.width) / static_cast<float>(options.height);
+    camera.fovy   = 45.0f;
+
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glViewport(0, 0, options.width, options.height);
+
+    world_renderer.render(camera, world, false, wireframe_renderer);
+
+    profiler.begin(graphics::Pass::WIREFRAME);
+    render_player_ui(camera, world, wireframe_renderer);
+    profiler.end(graphics::Pass::WIREFRAME);
+
+    glFinish();
+
+    auto frame_end = std::chrono::steady_clock::now();
+    if(i < WARMUP_FRAMES)
+      continue;
+
+    frame_times.push_back(std::chrono::duration<float, std::milli>(frame_end - frame_begin).count());
+    if(checksums)
+    {
+      context.read_pixels(pixels);
+      *checksums << fmt::format("{} {:016x}\n", frame, checksum(pixels));
+    }
+  }
+
+  // 3: Report
+  if(frame_times.empty())
+    return 0;
+
+  float total = 0.0f;
+  for(float frame_time : frame_times)
+    total += frame_time;
+
+  std::vector<float> sorted = frame_times;
+  std::sort(sorted.begin(), sorted.end());
+
+  fmt::print("frames = {}\n", sorted.size());
+  fmt::print("mean   = {:.3f} ms\n", total / sorted.size());
+  fmt::print("p50    = {:.3f} ms\n", percentile(sorted, 0.50f));
+  fmt::print("p90    = {:.3f} ms\n", percentile(sorted, 0.90f));
+  fmt::print("p99    = {:.3f} ms\n", percentile(sorted, 0.99f));
+  fmt::print("max    = {:.3f} ms\n", sorted.back());
+  fmt::print("{}\n", profiler.dump());
+  return 0;
+}
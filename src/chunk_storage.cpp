@@ -0,0 +1,89 @@
+#include <chunk_storage.hpp>
+
+#include <fmt/format.h>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <string.h>
+
+static constexpr char          CHUNK_MAGIC[8] = { 'V', 'O', 'X', 'Y', 'C', 'H', 'N', 'K' };
+static constexpr std::uint32_t CHUNK_VERSION  = 1;
+
+struct ChunkHeader
+{
+  char          magic[8];
+  std::uint32_t version;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::int32_t  x;
+  std::int32_t  y;
+  std::uint32_t reserved;
+};
+
+std::string chunk_path(std::string_view world_path, glm::ivec2 chunk_index)
+{
+  return fmt::format("{}/chunks/{}_{}.chunk", world_path, chunk_index.x, chunk_index.y);
+}
+
+bool chunk_exists(std::string_view world_path, glm::ivec2 chunk_index)
+{
+  return std::filesystem::exists(chunk_path(world_path, chunk_index));
+}
+
+void save_chunk(std::string_view world_path, glm::ivec2 chunk_index, const Chunk& chunk)
+{
+  ChunkHeader header = {};
+  memcpy(header.magic, CHUNK_MAGIC, sizeof CHUNK_MAGIC);
+  header.version = CHUNK_VERSION;
+  header.width   = CHUNK_WIDTH;
+  header.height  = CHUNK_HEIGHT;
+  header.x       = chunk_index.x;
+  header.y       = chunk_index.y;
+
+  std::string path     = chunk_path(world_path, chunk_index);
+  std::string tmp_path = path + ".tmp";
+
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+  if(ec)
+    throw std::runtime_error(fmt::format("Failed to create directory for chunk {}: {}", path, ec.message()));
+
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char *>(&header), sizeof header);
+    ofs.write(reinterpret_cast<const char *>(chunk.blocks), sizeof chunk.blocks);
+    if(!ofs)
+      throw std::runtime_error(fmt::format("Failed to write chunk {}", path));
+  }
+
+  std::filesystem::rename(tmp_path, path, ec);
+  if(ec)
+    throw std::runtime_error(fmt::format("Failed to write chunk {}: {}", path, ec.message()));
+}
+
+bool load_chunk(std::string_view world_path, glm::ivec2 chunk_index, Chunk& chunk)
+{
+  std::ifstream ifs(chunk_path(world_path, chunk_index), std::ios::binary);
+  if(!ifs)
+    return false;
+
+  ChunkHeader header;
+  if(!ifs.read(reinterpret_cast<char *>(&header), sizeof header))
+    return false;
+
+  if(memcmp(header.magic, CHUNK_MAGIC, sizeof CHUNK_MAGIC) != 0) return false;
+  if(header.version != CHUNK_VERSION)                             return false;
+  if(header.width   != CHUNK_WIDTH)                               return false;
+  if(header.height  != CHUNK_HEIGHT)                              return false;
+  if(header.x != chunk_index.x || header.y != chunk_index.y)      return false;
+
+  if(!ifs.read(reinterpret_cast<char *>(chunk.blocks), sizeof chunk.blocks))
+    return false;
+
+  compute_sky_heights(chunk);
+  chunk.state            = ChunkState::GENERATED;
+  chunk.mesh_invalidated = true;
+  return true;
+}
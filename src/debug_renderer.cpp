@@ -2,6 +2,8 @@
 
 #include <ray_cast.hpp>
 
+#include <graphics/profiler.hpp>
+
 #include <fmt/format.h>
 
 static constexpr float RAY_CAST_LENGTH = 20.0f;
@@ -20,7 +22,7 @@ void DebugRenderer::update(float dt)
   m_dts[DT_AVERAGE_COUNT-1] = dt;
 }
 
-void DebugRenderer::render(glm::vec2 viewport, const World& world, graphics::UIRenderer& ui_renderer)
+void DebugRenderer::render(glm::vec2 viewport, const World& world, const LightManager& light_manager, graphics::UIRenderer& ui_renderer)
 {
   // 1: Frame time
   float average = 0.0f;
@@ -61,7 +63,19 @@ void DebugRenderer::render(glm::vec2 viewport, const World& world, graphics::UIR
   render_line(viewport, n++, fmt::format("velocity: x = {}, y = {}, z = {}", player_entity.velocity.x, player_entity.velocity.y, player_entity.velocity.z), ui_renderer);
   render_line(viewport, n++, fmt::format("collided = {}", player_entity.collided), ui_renderer);
   render_line(viewport, n++, fmt::format("grounded = {}", player_entity.grounded), ui_renderer);
-  render_line(viewport, n++, fmt::format("average update time = {}", average), ui_renderer);
+  render_line(viewport, n++, fmt::format("average frame time = {:.2f} ms", average * 1000.0f), ui_renderer);
+
+  const graphics::Profiler&       profiler = graphics::Profiler::instance();
+  const graphics::RenderCounters& counters = profiler.last_counters();
+  render_line(viewport, n++, fmt::format("gpu: chunk = {:.2f} ms, entity = {:.2f} ms, wireframe = {:.2f} ms, ui = {:.2f} ms",
+        profiler.pass_time(graphics::Pass::CHUNK),
+        profiler.pass_time(graphics::Pass::ENTITY),
+        profiler.pass_time(graphics::Pass::WIREFRAME),
+        profiler.pass_time(graphics::Pass::UI)), ui_renderer);
+  render_line(viewport, n++, fmt::format("draw calls = {}, vertices = {}", counters.draw_calls, counters.vertices), ui_renderer);
+  render_line(viewport, n++, fmt::format("chunks: drawn = {}, culled = {}", counters.chunks_drawn, counters.chunks_culled), ui_renderer);
+  render_line(viewport, n++, fmt::format("uploaded = {} bytes", counters.bytes_uploaded), ui_renderer);
+  render_line(viewport, n++, fmt::format("light: pending = {}", light_manager.pending()), ui_renderer);
 
   if(block)
     render_line(viewport, n++, fmt::format("block: position = {}, {}, {}, id = {}, sky = {}, light level = {}", position.x, position.y, position.z, block->id, block->sky, block->light_level), ui_renderer);
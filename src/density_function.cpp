@@ -0,0 +1,330 @@
+#include <density_function.hpp>
+
+#include <yaml-cpp/yaml.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <assert.h>
+#include <stdint.h>
+
+struct DensityFunction::Node
+{
+  Op op;
+
+  float       value = 0.0f;
+  float       min   = 0.0f;
+  float       max   = 0.0f;
+  size_t      seed  = 0;
+  NoiseConfig noise = {};
+
+  std::vector<Node> children;
+};
+
+/*********
+ * Parse *
+ *********/
+DensityFunction::Node DensityFunction::parse(const YAML::Node& node, size_t seed, NoiseVersion version)
+{
+  auto parse_children = [&](Op op, const YAML::Node& args, size_t min_count, size_t max_count, const std::string& name) {
+    if(!args.IsSequence() || args.size() < min_count || args.size() > max_count)
+      throw std::runtime_error(fmt::format("Density function {} takes between {} and {} arguments", name, min_count, max_count));
+
+    Node result;
+    result.op = op;
+    for(const YAML::Node& child : args)
+      result.children.push_back(parse(child, seed, version));
+    return result;
+  };
+
+  if(!node.IsMap() || node.size() != 1)
+    throw std::runtime_error("Density function node must be a map with a single key");
+
+  std::string name = node.begin()->first.as<std::string>();
+  YAML::Node  args = node.begin()->second;
+
+  Node result;
+  if(name == "constant")
+  {
+    result.op    = Op::CONSTANT;
+    result.value = args.as<float>();
+  }
+  else if(name == "x") result.op = Op::X;
+  else if(name == "y") result.op = Op::Y;
+  else if(name == "z") result.op = Op::Z;
+  else if(name == "noise2" || name == "noise3")
+  {
+    size_t noise_seed = args["seed"] ? args["seed"].as<size_t>() : 0;
+
+    result.op    = name == "noise2" ? Op::NOISE2 : Op::NOISE3;
+    result.seed  = seed ^ (noise_seed * 0x9e3779b97f4a7c15 + 0x632be59bd9b4e019);
+    result.noise = load_noise_config(args, version);
+  }
+  else if(name == "add") result = parse_children(Op::ADD, args, 1, SIZE_MAX, name);
+  else if(name == "mul") result = parse_children(Op::MUL, args, 1, SIZE_MAX, name);
+  else if(name == "min") result = parse_children(Op::MIN, args, 1, SIZE_MAX, name);
+  else if(name == "max") result = parse_children(Op::MAX, args, 1, SIZE_MAX, name);
+  else if(name == "sub") result = parse_children(Op::SUB, args, 2, 2,        name);
+  else if(name == "neg" || name == "abs")
+  {
+    result.op = name == "neg" ? Op::NEG : Op::ABS;
+    result.children.push_back(parse(args, seed, version));
+  }
+  else if(name == "clamp")
+  {
+    result.op  = Op::CLAMP;
+    result.min = args["min"].as<float>();
+    result.max = args["max"].as<float>();
+    result.children.push_back(parse(args["value"], seed, version));
+  }
+  else if(name == "lerp")
+  {
+    result.op = Op::LERP;
+    result.children.push_back(parse(args["t"],    seed, version));
+    result.children.push_back(parse(args["from"], seed, version));
+    result.children.push_back(parse(args["to"],   seed, version));
+  }
+  else
+    throw std::runtime_error(fmt::format("Unknown density function {}", name));
+
+  return result;
+}
+
+/*****************
+ * Constant fold *
+ *****************/
+void DensityFunction::fold(Node& node)
+{
+  for(Node& child : node.children)
+    fold(child);
+
+  auto apply = [&](float a, float b) {
+    switch(node.op)
+    {
+    case Op::ADD: return a + b;
+    case Op::MUL: return a * b;
+    case Op::MIN: return std::min(a, b);
+    case Op::MAX: return std::max(a, b);
+    default: assert(false && "Unreachable"); return 0.0f;
+    }
+  };
+
+  auto is_constant = [](const Node& node) { return node.op == Op::CONSTANT; };
+  auto make_constant = [&](float value) {
+    node.op    = Op::CONSTANT;
+    node.value = value;
+    node.children.clear();
+  };
+
+  switch(node.op)
+  {
+  case Op::ADD:
+  case Op::MUL:
+  case Op::MIN:
+  case Op::MAX:
+  {
+    // Combine all constant operands into one, which may then turn out to be
+    // the identity or absorb everything else
+    std::vector<Node> children;
+    std::optional<float> constant;
+    for(Node& child : node.children)
+      if(is_constant(child))
+        constant = constant ? apply(*constant, child.value) : child.value;
+      else
+        children.push_back(std::move(child));
+
+    if(children.empty())
+      return make_constant(*constant);
+
+    if(constant)
+    {
+      bool identity = (node.op == Op::ADD && *constant == 0.0f) || (node.op == Op::MUL && *constant == 1.0f);
+      if(node.op == Op::MUL && *constant == 0.0f)
+        return make_constant(0.0f);
+
+      if(!identity)
+      {
+        Node constant_node;
+        constant_node.op    = Op::CONSTANT;
+        constant_node.value = *constant;
+        children.push_back(std::move(constant_node));
+      }
+    }
+
+    if(children.size() == 1)
+    {
+      Node child = std::move(children.front());
+      node = std::move(child);
+      return;
+    }
+
+    node.children = std::move(children);
+    return;
+  }
+  case Op::SUB:
+    if(is_constant(node.children[0]) && is_constant(node.children[1]))
+      return make_constant(node.children[0].value - node.children[1].value);
+    return;
+  case Op::NEG:
+    if(is_constant(node.children[0]))
+      return make_constant(-node.children[0].value);
+    return;
+  case Op::ABS:
+    if(is_constant(node.children[0]))
+      return make_constant(std::abs(node.children[0].value));
+    return;
+  case Op::CLAMP:
+    if(is_constant(node.children[0]))
+      return make_constant(std::clamp(node.children[0].value, node.min, node.max));
+    return;
+  case Op::LERP:
+    if(is_constant(node.children[0]))
+    {
+      float t = node.children[0].value;
+      if(t == 0.0f) { Node child = std::move(node.children[1]); node = std::move(child); return; }
+      if(t == 1.0f) { Node child = std::move(node.children[2]); node = std::move(child); return; }
+      if(is_constant(node.children[1]) && is_constant(node.children[2]))
+        return make_constant(node.children[1].value + (node.children[2].value - node.children[1].value) * t);
+    }
+    return;
+  default:
+    return;
+  }
+}
+
+/***********
+ * Compile *
+ ***********/
+unsigned DensityFunction::emit(const Node& node, std::vector<Instruction>& instructions, unsigned& register_count)
+{
+  Instruction instruction = {};
+  instruction.op    = node.op;
+  instruction.value = node.value;
+  instruction.min   = node.min;
+  instruction.max   = node.max;
+  instruction.seed  = node.seed;
+  instruction.noise = node.noise;
+
+  switch(node.op)
+  {
+  case Op::CONSTANT:
+  case Op::X:
+  case Op::Y:
+  case Op::Z:
+  case Op::NOISE2:
+  case Op::NOISE3:
+    instruction.dst = register_count++;
+    instructions.push_back(instruction);
+    return instruction.dst;
+  case Op::ADD:
+  case Op::MUL:
+  case Op::MIN:
+  case Op::MAX:
+  case Op::SUB:
+  {
+    // Accumulate into the register of the first operand, which belongs to
+    // nothing else
+    unsigned accumulator = emit(node.children[0], instructions, register_count);
+    for(size_t i=1; i<node.children.size(); ++i)
+    {
+      instruction.src[0] = accumulator;
+      instruction.src[1] = emit(node.children[i], instructions, register_count);
+      instruction.dst    = accumulator;
+      instructions.push_back(instruction);
+    }
+    return accumulator;
+  }
+  case Op::NEG:
+  case Op::ABS:
+  case Op::CLAMP:
+    instruction.src[0] = emit(node.children[0], instructions, register_count);
+    instruction.dst    = instruction.src[0];
+    instructions.push_back(instruction);
+    return instruction.dst;
+  case Op::LERP:
+    instruction.src[0] = emit(node.children[0], instructions, register_count);
+    instruction.src[1] = emit(node.children[1], instructions, register_count);
+    instruction.src[2] = emit(node.children[2], instructions, register_count);
+    instruction.dst    = instruction.src[0];
+    instructions.push_back(instruction);
+    return instruction.dst;
+  }
+  assert(false && "Unreachable");
+  return 0;
+}
+
+DensityFunction DensityFunction::compile(const YAML::Node& yaml, size_t seed, NoiseVersion version)
+{
+  Node node = parse(yaml, seed, version);
+  fold(node);
+
+  DensityFunction function;
+  function.m_register_count = 0;
+  function.m_result         = emit(node, function.m_instructions, function.m_register_count);
+  return function;
+}
+
+/************
+ * Evaluate *
+ ************/
+void DensityFunction::evaluate(glm::vec3 origin, glm::vec3 step, glm::uvec3 size, float *out) const
+{
+  const size_t count = size.x * size.y * size.z;
+
+  std::vector<float> registers(m_register_count * count);
+  std::vector<float> plane;
+  for(const Instruction& instruction : m_instructions)
+  {
+    float       *dst = &registers[instruction.dst    * count];
+    const float *a   = &registers[instruction.src[0] * count];
+    const float *b   = &registers[instruction.src[1] * count];
+    const float *c   = &registers[instruction.src[2] * count];
+    switch(instruction.op)
+    {
+    case Op::CONSTANT:
+      std::fill(dst, dst + count, instruction.value);
+      break;
+    case Op::X:
+    case Op::Y:
+    case Op::Z:
+    {
+      glm::length_t axis = instruction.op == Op::X ? 0 : instruction.op == Op::Y ? 1 : 2;
+      for(unsigned z=0; z<size.z; ++z)
+        for(unsigned y=0; y<size.y; ++y)
+          for(unsigned x=0; x<size.x; ++x)
+            dst[(z * size.y + y) * size.x + x] = origin[axis] + glm::uvec3(x, y, z)[axis] * step[axis];
+      break;
+    }
+    case Op::NOISE2:
+      plane.resize(size.x * size.y);
+      noise_grid(instruction.seed, glm::vec2(origin), glm::vec2(step), glm::uvec2(size), instruction.noise, plane.data());
+      for(unsigned z=0; z<size.z; ++z)
+        std::copy(plane.begin(), plane.end(), dst + z * plane.size());
+      break;
+    case Op::NOISE3:
+      noise_grid(instruction.seed, origin, step, size, instruction.noise, dst);
+      break;
+    case Op::ADD: for(size_t i=0; i<count; ++i) dst[i] = a[i] + b[i];           break;
+    case Op::SUB: for(size_t i=0; i<count; ++i) dst[i] = a[i] - b[i];           break;
+    case Op::MUL: for(size_t i=0; i<count; ++i) dst[i] = a[i] * b[i];           break;
+    case Op::MIN: for(size_t i=0; i<count; ++i) dst[i] = std::min(a[i], b[i]);  break;
+    case Op::MAX: for(size_t i=0; i<count; ++i) dst[i] = std::max(a[i], b[i]);  break;
+    case Op::NEG: for(size_t i=0; i<count; ++i) dst[i] = -a[i];                 break;
+    case Op::ABS: for(size_t i=0; i<count; ++i) dst[i] = std::abs(a[i]);        break;
+    case Op::CLAMP:
+      for(size_t i=0; i<count; ++i)
+        dst[i] = std::clamp(a[i], instruction.min, instruction.max);
+      break;
+    case Op::LERP:
+      for(size_t i=0; i<count; ++i)
+        dst[i] = b[i] + (c[i] - b[i]) * a[i];
+      break;
+    }
+  }
+
+  const float *result = &registers[m_result * count];
+  std::copy(result, result + count, out);
+}
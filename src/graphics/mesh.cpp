@@ -1,4 +1,5 @@
 #include <graphics/mesh.hpp>
+#include <graphics/profiler.hpp>
 
 #include <tiny_obj_loader.h>
 
@@ -67,7 +68,9 @@ namespace graphics
   Mesh::Mesh(IndexType index_type, PrimitiveType primitive_type, size_t stride, std::span<const Attribute> attributes) :
     m_index_type(index_type),
     m_primitive_type(primitive_type),
-    m_element_count(0)
+    m_stride(stride),
+    m_element_count(0),
+    m_vertex_count(0)
   {
     glGenVertexArrays(1, &m_vao);
     glGenBuffers(1, &m_ebo);
@@ -120,12 +123,15 @@ namespace graphics
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), _usage);
 
+    Profiler::instance().counters().bytes_uploaded += indices.size() + vertices.size();
+
     switch(m_index_type)
     {
     case IndexType::UNSIGNED_BYTE:  m_element_count = indices.size() / 1; break;
     case IndexType::UNSIGNED_SHORT: m_element_count = indices.size() / 2; break;
     case IndexType::UNSIGNED_INT:   m_element_count = indices.size() / 4; break;
     }
+    m_vertex_count = vertices.size() / m_stride;
   }
 
   void Mesh::draw() const
@@ -145,6 +151,10 @@ namespace graphics
 
     glBindVertexArray(m_vao);
     glDrawElements(mode, m_element_count, type, (void*)0);
+
+    RenderCounters& counters = Profiler::instance().counters();
+    counters.draw_calls += 1;
+    counters.vertices   += m_vertex_count;
   }
 }
 
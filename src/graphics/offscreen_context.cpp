@@ -0,0 +1,127 @@
+#include <graphics/offscreen_context.hpp>
+#include <graphics/window.hpp>
+
+#include <EGL/eglext.h>
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+
+namespace graphics
+{
+  static EGLDisplay get_display()
+  {
+    // Prefer the surfaceless platform so that we do not depend on a display
+    // server, and fall back to whatever the default display is otherwise.
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(extensions && std::strstr(extensions, "EGL_MESA_platform_surfaceless"))
+    {
+      auto eglGetPlatformDisplayEXT = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+      if(eglGetPlatformDisplayEXT)
+        if(EGLDisplay display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr); display != EGL_NO_DISPLAY)
+          return display;
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  OffscreenContext::OffscreenContext(unsigned width, unsigned height) : m_width(width), m_height(height)
+  {
+    m_display = get_display();
+    if(m_display == EGL_NO_DISPLAY || !eglInitialize(m_display, nullptr, nullptr))
+    {
+      spdlog::error("Failed to initialize EGL display: {:#x}", eglGetError());
+      std::exit(-1);
+    }
+
+    const EGLint config_attribs[] = {
+      EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE,
+    };
+
+    EGLConfig config;
+    EGLint    config_count;
+    if(!eglChooseConfig(m_display, config_attribs, &config, 1, &config_count) || config_count == 0)
+    {
+      spdlog::error("Failed to choose EGL config: {:#x}", eglGetError());
+      std::exit(-1);
+    }
+
+    if(!eglBindAPI(EGL_OPENGL_API))
+    {
+      spdlog::error("Failed to bind OpenGL API: {:#x}", eglGetError());
+      std::exit(-1);
+    }
+
+    // Shaders only need 4.3, which is also what llvmpipe supports everywhere
+    const EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION,       4,
+      EGL_CONTEXT_MINOR_VERSION,       3,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE,
+    };
+    m_context = eglCreateContext(m_display, config, EGL_NO_CONTEXT, context_attribs);
+    if(m_context == EGL_NO_CONTEXT)
+    {
+      spdlog::error("Failed to create EGL context: {:#x}", eglGetError());
+      std::exit(-1);
+    }
+
+    if(!eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_context))
+    {
+      spdlog::error("Failed to make EGL context current: {:#x}", eglGetError());
+      std::exit(-1);
+    }
+
+    if(!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+      spdlog::error("Failed to create Load OpenGL functions");
+      std::exit(-1);
+    }
+
+    spdlog::info("Offscreen context: {} ({})", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+
+    glGenRenderbuffers(1, &m_color_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_color_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_width, m_height);
+
+    glGenRenderbuffers(1, &m_depth_rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depth_rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_width, m_height);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color_rbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, m_depth_rbo);
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+      spdlog::error("Failed to create offscreen framebuffer");
+      std::exit(-1);
+    }
+
+    setup_gl_state();
+  }
+
+  OffscreenContext::~OffscreenContext()
+  {
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteRenderbuffers(1, &m_color_rbo);
+    glDeleteRenderbuffers(1, &m_depth_rbo);
+
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(m_display, m_context);
+    eglTerminate(m_display);
+  }
+
+  void OffscreenContext::get_framebuffer_size(int& width, int& height)
+  {
+    width  = m_width;
+    height = m_height;
+  }
+
+  void OffscreenContext::read_pixels(std::vector<std::uint8_t>& pixels)
+  {
+    pixels.resize(m_width * m_height * 4);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  }
+}
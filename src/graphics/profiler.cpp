@@ -0,0 +1,114 @@
+#include <graphics/profiler.hpp>
+
+#include <fmt/format.h>
+
+#include <assert.h>
+
+namespace graphics
+{
+  const char *pass_name(Pass pass)
+  {
+    switch(pass)
+    {
+    case Pass::CHUNK:     return "chunk";
+    case Pass::ENTITY:    return "entity";
+    case Pass::WIREFRAME: return "wireframe";
+    case Pass::UI:        return "ui";
+    case Pass::COUNT:     break;
+    }
+    return "unknown";
+  }
+
+  Profiler& Profiler::instance()
+  {
+    static Profiler profiler;
+    return profiler;
+  }
+
+  void Profiler::release()
+  {
+    for(Frame& frame : m_frames)
+    {
+      if(!frame.queries.empty())
+        glDeleteQueries(frame.queries.size(), frame.queries.data());
+
+      frame.queries.clear();
+      frame.passes.clear();
+      frame.used = 0;
+    }
+  }
+
+  void Profiler::begin_frame()
+  {
+    m_last_counters = m_counters;
+    m_counters      = {};
+
+    m_current = (m_current + 1) % FRAME_COUNT;
+    collect(m_frames[m_current]);
+    m_frames[m_current].used = 0;
+    m_frames[m_current].passes.clear();
+
+    ++m_frame_number;
+  }
+
+  void Profiler::begin(Pass pass)
+  {
+    Frame& frame = m_frames[m_current];
+    if(frame.used + 2 > frame.queries.size())
+    {
+      size_t old_size = frame.queries.size();
+      frame.queries.resize(old_size + 2);
+      glGenQueries(2, &frame.queries[old_size]);
+    }
+
+    glQueryCounter(frame.queries[frame.used++], GL_TIMESTAMP);
+    frame.passes.push_back(pass);
+  }
+
+  void Profiler::end(Pass pass)
+  {
+    Frame& frame = m_frames[m_current];
+    assert(!frame.passes.empty() && frame.passes.back() == pass);
+    glQueryCounter(frame.queries[frame.used++], GL_TIMESTAMP);
+  }
+
+  void Profiler::collect(Frame& frame)
+  {
+    if(frame.used == 0)
+      return;
+
+    // Queries complete in order, so checking the last one is enough
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(frame.queries[frame.used-1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available)
+      return;
+
+    float pass_times[static_cast<std::size_t>(Pass::COUNT)] = {};
+    for(size_t i=0; i<frame.passes.size(); ++i)
+    {
+      GLuint64 begin, end;
+      glGetQueryObjectui64v(frame.queries[i*2+0], GL_QUERY_RESULT, &begin);
+      glGetQueryObjectui64v(frame.queries[i*2+1], GL_QUERY_RESULT, &end);
+      pass_times[static_cast<std::size_t>(frame.passes[i])] += (end - begin) / 1e6f;
+    }
+
+    for(size_t i=0; i<static_cast<std::size_t>(Pass::COUNT); ++i)
+      m_pass_times[i] = pass_times[i];
+  }
+
+  std::string Profiler::dump() const
+  {
+    std::string passes;
+    for(size_t i=0; i<static_cast<std::size_t>(Pass::COUNT); ++i)
+      passes += fmt::format("{}\"{}\":{}", i == 0 ? "" : ",", pass_name(static_cast<Pass>(i)), m_pass_times[i]);
+
+    return fmt::format("{{\"frame\":{},\"pass_ms\":{{{}}},\"draw_calls\":{},\"vertices\":{},\"chunks_drawn\":{},\"chunks_culled\":{},\"bytes_uploaded\":{}}}",
+        m_frame_number,
+        passes,
+        m_last_counters.draw_calls,
+        m_last_counters.vertices,
+        m_last_counters.chunks_drawn,
+        m_last_counters.chunks_culled,
+        m_last_counters.bytes_uploaded);
+  }
+}
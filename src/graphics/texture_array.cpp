@@ -1,43 +1,274 @@
 #include <graphics/texture_array.hpp>
 
+#include <lazy.hpp>
+
 #include <stb_image.h>
 
+#include <spdlog/spdlog.h>
+
+#include <experimental/scope>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <fstream>
+#include <deque>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <assert.h>
+#include <string.h>
 
 namespace graphics
 {
-  TextureArray::TextureArray(const std::vector<std::string>& filenames)
+  static constexpr char          CACHE_MAGIC[8] = { 'V', 'O', 'X', 'Y', 'T', 'E', 'X', 'A' };
+  static constexpr std::uint32_t CACHE_VERSION  = 1;
+
+  static constexpr std::uint32_t MAX_CACHE_DIMENSION = 65536;
+
+  struct CacheHeader
   {
-    glGenTextures(1, &m_id);
-    glBindTexture(GL_TEXTURE_2D_ARRAY, m_id);
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t depth;
+    std::uint32_t levels;
+    std::uint32_t reserved;
+    std::uint64_t key;
+    std::uint64_t size;
+  };
 
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,     GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,     GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  struct Image
+  {
+    unsigned width;
+    unsigned height;
+    std::vector<std::vector<unsigned char>> levels;
+  };
+
+  static unsigned level_count(unsigned width, unsigned height)
+  {
+    unsigned levels = 1;
+    while((width >> levels) != 0 || (height >> levels) != 0)
+      ++levels;
+    return levels;
+  }
+
+  static size_t level_size(unsigned width, unsigned height, unsigned level)
+  {
+    return static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4;
+  }
 
-    std::vector<stbi_uc> bytes;
-    int width  = 0;
-    int height = 0;
-    int depth  = filenames.size();
+  // Key identifying the exact set of source files the cache was baked from.
+  // Any rename, reorder or modification of the source textures invalidates it.
+  static std::uint64_t cache_key(const std::vector<std::string>& filenames)
+  {
+    std::uint64_t key = 0xcbf29ce484222325;
+    auto feed = [&key](const void *data, size_t size) {
+      const unsigned char *bytes = static_cast<const unsigned char *>(data);
+      for(size_t i=0; i<size; ++i)
+      {
+        key ^= bytes[i];
+        key *= 0x100000001b3;
+      }
+    };
 
-    stbi_set_flip_vertically_on_load(true);
     for(const std::string& filename : filenames)
     {
-      int _width, _height, channels_in_file;
-      stbi_uc *_bytes = stbi_load(filename.c_str(), &_width, &_height, &channels_in_file, STBI_rgb_alpha);
-      assert(_bytes);
-      if(width  == 0) width  = _width;  else assert(width  == _width);
-      if(height == 0) height = _height; else assert(height == _height);
-      bytes.insert(bytes.end(), &_bytes[0], &_bytes[width * height * 4]);
-      stbi_image_free(_bytes);
+      std::error_code ec;
+      std::uintmax_t size  = std::filesystem::file_size(filename, ec);
+      auto           mtime = std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+
+      feed(filename.data(), filename.size() + 1);
+      feed(&size,  sizeof size);
+      feed(&mtime, sizeof mtime);
+    }
+    return key;
+  }
+
+  static std::optional<Image> decode_image(const std::string& filename)
+  {
+    stbi_set_flip_vertically_on_load_thread(true);
+
+    int width, height, channels_in_file;
+    stbi_uc *bytes = stbi_load(filename.c_str(), &width, &height, &channels_in_file, STBI_rgb_alpha);
+    if(!bytes)
+    {
+      spdlog::error("Failed to load texture {}: {}", filename, stbi_failure_reason());
+      return std::nullopt;
+    }
+    std::experimental::scope_exit bytes_exit([bytes]() { stbi_image_free(bytes); });
+
+    Image image;
+    image.width  = width;
+    image.height = height;
+    image.levels.emplace_back(&bytes[0], &bytes[width * height * 4]);
+
+    // Box filter each level down from the previous one
+    unsigned levels = level_count(width, height);
+    for(unsigned level=1; level<levels; ++level)
+    {
+      const std::vector<unsigned char>& src = image.levels[level-1];
+      unsigned src_width  = std::max(image.width  >> (level-1), 1u);
+      unsigned src_height = std::max(image.height >> (level-1), 1u);
+      unsigned dst_width  = std::max(image.width  >> level, 1u);
+      unsigned dst_height = std::max(image.height >> level, 1u);
+
+      std::vector<unsigned char> dst(level_size(image.width, image.height, level));
+      for(unsigned y=0; y<dst_height; ++y)
+        for(unsigned x=0; x<dst_width; ++x)
+        {
+          unsigned x0 = std::min(x * 2, src_width  - 1), x1 = std::min(x * 2 + 1, src_width  - 1);
+          unsigned y0 = std::min(y * 2, src_height - 1), y1 = std::min(y * 2 + 1, src_height - 1);
+          for(unsigned c=0; c<4; ++c)
+          {
+            unsigned sum = src[(y0 * src_width + x0) * 4 + c]
+                         + src[(y0 * src_width + x1) * 4 + c]
+                         + src[(y1 * src_width + x0) * 4 + c]
+                         + src[(y1 * src_width + x1) * 4 + c];
+            dst[(y * dst_width + x) * 4 + c] = (sum + 2) / 4;
+          }
+        }
+      image.levels.push_back(std::move(dst));
+    }
+
+    return image;
+  }
+
+  static std::unique_ptr<TextureArray> load_from_cache(const std::string& cache_filename, std::uint64_t key, unsigned depth)
+  {
+    int fd = open(cache_filename.c_str(), O_RDONLY);
+    if(fd == -1)
+      return nullptr;
+    std::experimental::scope_exit fd_exit([fd]() { close(fd); });
+
+    struct stat st;
+    if(fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader))
+      return nullptr;
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)
+      return nullptr;
+    std::experimental::scope_exit data_exit([data, size = st.st_size]() { munmap(data, size); });
+
+    CacheHeader header;
+    memcpy(&header, data, sizeof header);
+    if(memcmp(header.magic, CACHE_MAGIC, sizeof CACHE_MAGIC) != 0) return nullptr;
+    if(header.version != CACHE_VERSION)                             return nullptr;
+    if(header.key     != key)                                       return nullptr;
+    if(header.depth   != depth)                                     return nullptr;
+    if(header.size    != st.st_size - sizeof header)                return nullptr;
+
+    // The dimensions decide how much of the payload gets uploaded, so they had
+    // better agree with its size
+    if(header.width  == 0 || header.width  > MAX_CACHE_DIMENSION)  return nullptr;
+    if(header.height == 0 || header.height > MAX_CACHE_DIMENSION)  return nullptr;
+    if(header.levels != level_count(header.width, header.height))  return nullptr;
+
+    std::uint64_t size = 0;
+    for(unsigned level=0; level<header.levels; ++level)
+      size += static_cast<std::uint64_t>(level_size(header.width, header.height, level)) * header.depth;
+    if(header.size != size)                                         return nullptr;
+
+    spdlog::info("Loading texture array from cache {}", cache_filename);
+    const unsigned char *bytes = static_cast<const unsigned char *>(data) + sizeof header;
+    return std::make_unique<TextureArray>(bytes, header.width, header.height, header.depth, header.levels);
+  }
+
+  static void write_cache(const std::string& cache_filename, std::uint64_t key, unsigned width, unsigned height, unsigned depth, unsigned levels, const std::vector<unsigned char>& bytes)
+  {
+    CacheHeader header = {};
+    memcpy(header.magic, CACHE_MAGIC, sizeof CACHE_MAGIC);
+    header.version = CACHE_VERSION;
+    header.width   = width;
+    header.height  = height;
+    header.depth   = depth;
+    header.levels  = levels;
+    header.key     = key;
+    header.size    = bytes.size();
+
+    // Write to a temporary file first so that a crash never leaves behind a
+    // truncated cache with a valid header.
+    std::string tmp_filename = cache_filename + ".tmp";
+    {
+      std::ofstream ofs(tmp_filename, std::ios::binary | std::ios::trunc);
+      ofs.write(reinterpret_cast<const char *>(&header), sizeof header);
+      ofs.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+      if(!ofs)
+      {
+        spdlog::warn("Failed to write texture array cache {}", cache_filename);
+        return;
+      }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_filename, cache_filename, ec);
+    if(ec)
+      spdlog::warn("Failed to write texture array cache {}: {}", cache_filename, ec.message());
+  }
+
+  std::unique_ptr<TextureArray> TextureArray::load_from(const std::vector<std::string>& filenames, const std::string& cache_filename)
+  {
+    std::uint64_t key = cache_key(filenames);
+    if(std::unique_ptr<TextureArray> texture_array = load_from_cache(cache_filename, key, filenames.size()))
+      return texture_array;
+
+    // 1: Decode all images in parallel
+    std::deque<Lazy<std::optional<Image>>> images;
+    for(const std::string& filename : filenames)
+      images.emplace_back([filename]() { return decode_image(filename); });
+
+    unsigned width  = 0;
+    unsigned height = 0;
+    unsigned depth  = filenames.size();
+    for(Lazy<std::optional<Image>>& image : images)
+    {
+      if(!image.get())
+        throw std::runtime_error("Failed to load texture array");
+
+      if(width  == 0) width  = image.get()->width;  else if(width  != image.get()->width)  throw std::runtime_error("Mismatched texture width in texture array");
+      if(height == 0) height = image.get()->height; else if(height != image.get()->height) throw std::runtime_error("Mismatched texture height in texture array");
     }
     assert(width  != 0);
     assert(height != 0);
 
-    assert(bytes.size() == width * height * depth * 4);
+    // 2: Assemble into level-major layout
+    unsigned levels = level_count(width, height);
 
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, bytes.data());
+    std::vector<unsigned char> bytes;
+    for(unsigned level=0; level<levels; ++level)
+      for(Lazy<std::optional<Image>>& image : images)
+      {
+        const std::vector<unsigned char>& level_bytes = image.get()->levels[level];
+        bytes.insert(bytes.end(), level_bytes.begin(), level_bytes.end());
+      }
+
+    // 3: Bake and upload
+    write_cache(cache_filename, key, width, height, depth, levels, bytes);
+    return std::make_unique<TextureArray>(bytes.data(), width, height, depth, levels);
+  }
+
+  TextureArray::TextureArray(const unsigned char *bytes, unsigned width, unsigned height, unsigned depth, unsigned levels)
+  {
+    glGenTextures(1, &m_id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_id);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,     GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,     GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL,  levels - 1);
+
+    for(unsigned level=0; level<levels; ++level)
+    {
+      GLsizei level_width  = std::max(width  >> level, 1u);
+      GLsizei level_height = std::max(height >> level, 1u);
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA, level_width, level_height, depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, bytes);
+      bytes += level_size(width, height, level) * depth;
+    }
   }
 
   TextureArray::~TextureArray()
@@ -45,4 +276,3 @@ namespace graphics
     glDeleteTextures(1, &m_id);
   }
 }
-
@@ -9,6 +9,21 @@ namespace graphics
     fprintf(stderr, "OpenGL Error: type = %u: %s\n", type, message);
   }
 
+  void setup_gl_state()
+  {
+    glDebugMessageCallback(message_callback, 0);
+
+    glEnable(GL_LINE_SMOOTH);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_PACK_ALIGNMENT,   1);
+  }
+
   Window::Window(const char *title, unsigned width, unsigned height)
   {
     if(!glfwInit())
@@ -43,17 +58,7 @@ namespace graphics
       std::exit(-1);
     }
 
-    glDebugMessageCallback(message_callback, 0);
-
-    glEnable(GL_LINE_SMOOTH);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glPixelStorei(GL_PACK_ALIGNMENT,   1);
+    setup_gl_state();
   }
 
   void Window::poll_events()
@@ -1,102 +1,444 @@
 #include <light_manager.hpp>
 
-void LightManager::invalidate(glm::ivec3 position)
+#include <coordinates.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <latch>
+#include <limits>
+#include <memory>
+#include <thread>
+
+// The first four directions lead into the neighbouring chunk of the same index
+// when stepping over the border
+static constexpr glm::ivec3 DIRECTIONS[] = {
+  {-1, 0, 0}, {1, 0, 0},
+  {0, -1, 0}, {0, 1, 0},
+  {0, 0, -1}, {0, 0, 1},
+};
+
+static std::uint16_t pack(glm::ivec3 position)
 {
-  m_invalidations.emplace(position, Invalidation{});
+  return (position.z * CHUNK_WIDTH + position.y) * CHUNK_WIDTH + position.x;
 }
 
-void LightManager::update(World& world)
+static glm::ivec3 unpack(std::uint16_t index)
+{
+  return glm::ivec3(index % CHUNK_WIDTH, index / CHUNK_WIDTH % CHUNK_WIDTH, index / CHUNK_WIDTH / CHUNK_WIDTH);
+}
+
+static bool is_inside(glm::ivec3 position)
+{
+  return position.x >= 0 && position.x < CHUNK_WIDTH && position.y >= 0 && position.y < CHUNK_WIDTH;
+}
+
+static glm::ivec3 wrap(glm::ivec3 position)
+{
+  return glm::ivec3((position.x + CHUNK_WIDTH) % CHUNK_WIDTH, (position.y + CHUNK_WIDTH) % CHUNK_WIDTH, position.z);
+}
+
+static Block& get(Chunk& chunk, glm::ivec3 position)
+{
+  return chunk.blocks[position.z][position.y][position.x];
+}
+
+// Call f on items in order, spread over the thread pool and the calling thread.
+// Items are handed out one at a time to whichever thread asks first, so that
+// the calling thread never ends up waiting for a helper still stuck behind
+// other jobs on the thread pool. Items left once the deadline has passed are
+// skipped, except for the first one.
+template<typename T>
+static void parallel_for_each(const std::vector<T*>& items, std::function<void(T&)> f, std::chrono::steady_clock::time_point deadline)
 {
-  std::unordered_set<glm::ivec3>               updates;
-  std::unordered_map<glm::ivec3, Invalidation> new_invalidations;
-  while(!m_invalidations.empty())
+  if(items.size() == 1)
+    return f(*items[0]);
+
+  struct State
   {
-    /*************
-     * 1: Update *
-     *************/
-    for(auto& [position, invalidation] : m_invalidations)
+    State(const std::vector<T*>& items, std::function<void(T&)> f, std::chrono::steady_clock::time_point deadline) : items(items), f(std::move(f)), deadline(deadline), done(items.size()) {}
+
+    std::vector<T*>                       items;
+    std::function<void(T&)>               f;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<size_t>                   next = 0;
+    std::latch                            done;
+  };
+
+  auto state = std::make_shared<State>(items, std::move(f), deadline);
+  auto work = [state]() {
+    for(size_t i; (i = state->next.fetch_add(1, std::memory_order_relaxed)) < state->items.size();)
     {
-      invalidation.block = get_block(world, position);
-      if(!invalidation.block)
-        continue;
+      if(i == 0 || std::chrono::steady_clock::now() < state->deadline)
+        state->f(*state->items[i]);
+      state->done.count_down();
+    }
+  };
+
+  size_t helper_count = std::min<size_t>(items.size() - 1, std::thread::hardware_concurrency());
+  for(size_t i=0; i<helper_count; ++i)
+    ThreadPool::instance().enqueue(work);
+
+  work();
+  state->done.wait();
+}
 
-      // 1: Solid block
-      if(invalidation.block->id != BLOCK_ID_NONE)
+LightManager::Region& LightManager::region(World& world, glm::ivec2 chunk_index, Chunk& chunk)
+{
+  auto [it, inserted] = m_regions.try_emplace(chunk_index);
+
+  Region& region = it->second;
+  if(inserted)
+  {
+    region.chunk       = &chunk;
+    region.chunk_index = chunk_index;
+    find_neighbours(world, region);
+    chunk.state = ChunkState::GENERATED;
+  }
+  return region;
+}
+
+void LightManager::find_neighbours(World& world, Region& region)
+{
+  for(int i=0; i<4; ++i)
+  {
+    auto neighbour_it = world.chunks.find(region.chunk_index + glm::ivec2(DIRECTIONS[i]));
+    region.neighbours[i] = neighbour_it != world.chunks.end() ? &neighbour_it->second : nullptr;
+  }
+}
+
+void LightManager::remove(Region& region, glm::ivec3 position, Block& block)
+{
+  region.removals.push(Node{pack(position), static_cast<std::uint8_t>(block.light_level)});
+  mark_updated(region, position);
+
+  block.sky         = false;
+  block.light_level = 0;
+
+  // Air next to a chunk that is not loaded is lit by it no matter what
+  if(block.id == BLOCK_ID_NONE)
+    for(int i=0; i<4; ++i)
+      if(!is_inside(position + DIRECTIONS[i]) && !region.neighbours[i])
       {
-        invalidation.new_sky         = false;
-        invalidation.new_light_level = 0;
-        continue;
+        block.light_level = 14;
+        region.additions.push(pack(position));
+        break;
       }
+}
 
-      // 2: Direct Skylight
-      if(position.z == CHUNK_HEIGHT - 1)
-      {
-        invalidation.new_sky         = true;
-        invalidation.new_light_level = 15;
+void LightManager::mark_updated(Region& region, glm::ivec3 position)
+{
+  region.updates |= 1;
+  for(int i=0; i<4; ++i)
+    if(!is_inside(position + DIRECTIONS[i]))
+      region.updates |= 1 << (i + 1);
+}
+
+void LightManager::update_sky_height(Region& region, glm::ivec3 position)
+{
+  Chunk&         chunk      = *region.chunk;
+  std::uint16_t& sky_height = chunk.sky_heights[position.y][position.x];
+
+  int old_sky_height = sky_height;
+  int new_sky_height = sky_height;
+  if(get(chunk, position).id != BLOCK_ID_NONE)
+    new_sky_height = std::max(new_sky_height, position.z + 1);
+  else if(position.z + 1 == old_sky_height)
+    while(new_sky_height > 0 && chunk.blocks[new_sky_height-1][position.y][position.x].id == BLOCK_ID_NONE)
+      --new_sky_height;
+
+  sky_height = new_sky_height;
+
+  // Blocks that have just been covered up, including the block covering them
+  for(int z=old_sky_height; z<new_sky_height; ++z)
+  {
+    Block& block = chunk.blocks[z][position.y][position.x];
+    if(block.sky || block.light_level != 0)
+      remove(region, glm::ivec3(position.x, position.y, z), block);
+  }
+
+  // Blocks that have just been uncovered
+  for(int z=new_sky_height; z<old_sky_height; ++z)
+  {
+    Block& block = chunk.blocks[z][position.y][position.x];
+    block.sky         = true;
+    block.light_level = 15;
+    mark_updated(region, glm::ivec3(position.x, position.y, z));
+    region.additions.push(pack(glm::ivec3(position.x, position.y, z)));
+  }
+}
+
+void LightManager::process_removals(Region& region)
+{
+  // Light that is dimmer than the light removed may have come from it, unless
+  // it comes straight from the sky
+  auto visit = [&](glm::ivec3 position, unsigned light_level) {
+    Block& block = get(*region.chunk, position);
+    if(block.id != BLOCK_ID_NONE)
+      return;
+
+    if(!block.sky && block.light_level != 0 && block.light_level < light_level)
+      remove(region, position, block);
+    else if(block.light_level >= light_level)
+      region.additions.push(pack(position));
+  };
+
+  std::vector<Node>& inbox = region.inboxes[static_cast<int>(Phase::REMOVAL)];
+  for(Node node : inbox)
+    visit(unpack(node.index), node.light_level);
+  inbox.clear();
+
+  while(!region.removals.empty())
+  {
+    Node       node     = region.removals.pop();
+    glm::ivec3 position = unpack(node.index);
+    for(int i=0; i<6; ++i)
+    {
+      glm::ivec3 neighbour_position = position + DIRECTIONS[i];
+      if(neighbour_position.z < 0 || neighbour_position.z >= CHUNK_HEIGHT)
         continue;
-      }
 
-      // 3: Indirect Skylight
-      if(const Block* neighbour_block = get_block(world, position + glm::ivec3(0, 0, 1)); neighbour_block->sky)
-      {
-        invalidation.new_sky         = true;
-        invalidation.new_light_level = 15;
+      if(is_inside(neighbour_position))
+        visit(neighbour_position, node.light_level);
+      else if(region.neighbours[i])
+        region.outboxes[static_cast<int>(Phase::REMOVAL)][i].push_back(Node{pack(wrap(neighbour_position)), node.light_level});
+    }
+  }
+}
+
+void LightManager::process_additions(Region& region)
+{
+  auto visit = [&](glm::ivec3 position, unsigned light_level) {
+    Block& block = get(*region.chunk, position);
+    if(block.id != BLOCK_ID_NONE || block.light_level >= light_level)
+      return;
+
+    block.light_level = light_level;
+    mark_updated(region, position);
+    region.additions.push(pack(position));
+  };
+
+  std::vector<Node>& inbox = region.inboxes[static_cast<int>(Phase::ADDITION)];
+  for(Node node : inbox)
+    visit(unpack(node.index), node.light_level);
+  inbox.clear();
+
+  while(!region.additions.empty())
+  {
+    glm::ivec3 position    = unpack(region.additions.pop());
+    unsigned   light_level = get(*region.chunk, position).light_level;
+    if(light_level <= 1)
+      continue;
+
+    for(int i=0; i<6; ++i)
+    {
+      glm::ivec3 neighbour_position = position + DIRECTIONS[i];
+      if(neighbour_position.z < 0 || neighbour_position.z >= CHUNK_HEIGHT)
         continue;
-      }
 
-      // 4: Neighbours
-      int light_level_max = 0;
-      { const Block* neighbour_block = get_block(world, position + glm::ivec3(-1, 0, 0)); light_level_max = std::max<int>(light_level_max, neighbour_block ? neighbour_block->light_level : 15); if(light_level_max == 15) goto end; }
-      { const Block* neighbour_block = get_block(world, position + glm::ivec3( 1, 0, 0)); light_level_max = std::max<int>(light_level_max, neighbour_block ? neighbour_block->light_level : 15); if(light_level_max == 15) goto end; }
-      { const Block* neighbour_block = get_block(world, position + glm::ivec3(0, -1, 0)); light_level_max = std::max<int>(light_level_max, neighbour_block ? neighbour_block->light_level : 15); if(light_level_max == 15) goto end; }
-      { const Block* neighbour_block = get_block(world, position + glm::ivec3(0,  1, 0)); light_level_max = std::max<int>(light_level_max, neighbour_block ? neighbour_block->light_level : 15); if(light_level_max == 15) goto end; }
-      { const Block* neighbour_block = get_block(world, position + glm::ivec3(0, 0, -1)); light_level_max = std::max<int>(light_level_max, neighbour_block ? neighbour_block->light_level : 15); if(light_level_max == 15) goto end; }
-      { const Block* neighbour_block = get_block(world, position + glm::ivec3(0, 0,  1)); light_level_max = std::max<int>(light_level_max, neighbour_block ? neighbour_block->light_level : 15); if(light_level_max == 15) goto end; }
-end:
-
-      invalidation.new_sky         = false;
-      invalidation.new_light_level = light_level_max > 0 ? light_level_max - 1 : 0;
+      if(is_inside(neighbour_position))
+        visit(neighbour_position, light_level - 1);
+      else if(region.neighbours[i])
+        region.outboxes[static_cast<int>(Phase::ADDITION)][i].push_back(Node{pack(wrap(neighbour_position)), static_cast<std::uint8_t>(light_level - 1)});
     }
+  }
+}
 
-    /*************
-     * 2: commit *
-     *************/
-    for(auto& [position, invalidation] : m_invalidations)
-      if(invalidation.block)
-      {
-        if(invalidation.block->sky != invalidation.new_sky)
-        {
-          invalidation.block->sky = invalidation.new_sky;
-          new_invalidations.emplace(position + glm::ivec3(0, 0, -1), Invalidation{});
-        }
+void LightManager::run(World& world, std::chrono::steady_clock::time_point deadline)
+{
+  /***************************************************************
+   * 1: Neighbours of regions left over from the last update may *
+   *    have been loaded in the meantime                         *
+   ***************************************************************/
+  for(auto& [chunk_index, region] : m_regions)
+    find_neighbours(world, region);
 
-        if(invalidation.block->light_level != invalidation.new_light_level)
+  /***********************************************************************
+   * 2: Compare invalidated blocks against what their surroundings allow *
+   ***********************************************************************/
+  for(glm::ivec3 position : m_invalidations)
+  {
+    auto [local_position, chunk_index] = coordinates::split(position);
+    auto it = world.chunks.find(chunk_index);
+    if(it == world.chunks.end())
+      continue;
+
+    Region& region = this->region(world, chunk_index, it->second);
+    Block&  block  = get(*region.chunk, local_position);
+
+    update_sky_height(region, local_position);
+
+    bool     sky         = false;
+    unsigned light_level = 0;
+    if(block.id == BLOCK_ID_NONE)
+    {
+      sky = local_position.z >= region.chunk->sky_heights[local_position.y][local_position.x];
+      if(sky)
+        light_level = 15;
+      else
+        for(int i=0; i<6; ++i)
         {
-          invalidation.block->light_level = invalidation.new_light_level;
-          new_invalidations.emplace(position + glm::ivec3(-1, 0, 0), Invalidation{});
-          new_invalidations.emplace(position + glm::ivec3( 1, 0, 0), Invalidation{});
-          new_invalidations.emplace(position + glm::ivec3(0, -1, 0), Invalidation{});
-          new_invalidations.emplace(position + glm::ivec3(0,  1, 0), Invalidation{});
-          new_invalidations.emplace(position + glm::ivec3(0, 0, -1), Invalidation{});
-          new_invalidations.emplace(position + glm::ivec3(0, 0,  1), Invalidation{});
-          updates.insert(position);
+          // Missing horizontal neighbours are chunks that are not loaded, and
+          // missing vertical neighbours are beyond the bottom of the world
+          glm::ivec3 neighbour_position = local_position + DIRECTIONS[i];
+
+          unsigned neighbour_light_level;
+          if(neighbour_position.z < 0 || neighbour_position.z >= CHUNK_HEIGHT)
+            neighbour_light_level = 0;
+          else if(is_inside(neighbour_position))
+            neighbour_light_level = get(*region.chunk, neighbour_position).light_level;
+          else if(region.neighbours[i])
+            neighbour_light_level = get(*region.neighbours[i], wrap(neighbour_position)).light_level;
+          else
+            neighbour_light_level = 15;
+
+          if(neighbour_light_level > 0)
+            light_level = std::max(light_level, neighbour_light_level - 1);
         }
-      }
+    }
+
+    // Anything brighter than its surroundings allow may have been lighting up
+    // its surroundings in turn, so all of that has to go first. Anything
+    // darker can simply be brightened.
+    if(block.sky > sky || block.light_level > light_level)
+      remove(region, local_position, block);
+    else if(block.sky < sky || block.light_level < light_level)
+    {
+      block.sky         = sky;
+      block.light_level = light_level;
+      mark_updated(region, local_position);
+      region.additions.push(pack(local_position));
+    }
+  }
+  m_invalidations.clear();
+
+  // Chunks that were just loaded get a region even with nothing to do, so that
+  // they are marked as lit below
+  for(glm::ivec2 chunk_index : m_chunk_invalidations)
+    if(auto it = world.chunks.find(chunk_index); it != world.chunks.end())
+      region(world, chunk_index, it->second);
+  m_chunk_invalidations.clear();
 
+  /*************************************************************
+   * 3: Propagate changes until done or out of time, in rounds *
+   *************************************************************/
+  auto has_removals  = [](const Region& region) { return !region.removals.empty()  || !region.inboxes[static_cast<int>(Phase::REMOVAL)].empty(); };
+  auto has_additions = [](const Region& region) { return !region.additions.empty() || !region.inboxes[static_cast<int>(Phase::ADDITION)].empty(); };
+
+  std::vector<Region*> regions;
+  for(;;)
+  {
+    // 3.1: Hand light that crossed a chunk border over to the chunk on the
+    //      other side. This may create new regions, so collect senders first.
+    regions.clear();
+    for(auto& [chunk_index, region] : m_regions)
+      regions.push_back(&region);
 
-    // 3: Iterate
-    m_invalidations = std::move(new_invalidations);
-    new_invalidations.clear();
+    for(Region* sender : regions)
+      for(int phase=0; phase<2; ++phase)
+        for(int i=0; i<4; ++i)
+          if(std::vector<Node>& outbox = sender->outboxes[phase][i]; !outbox.empty())
+          {
+            Region& receiver = region(world, sender->chunk_index + glm::ivec2(DIRECTIONS[i]), *sender->neighbours[i]);
+            receiver.inboxes[phase].insert(receiver.inboxes[phase].end(), outbox.begin(), outbox.end());
+            outbox.clear();
+          }
+
+    // 3.2: All removals have to be done before anything is spread back in, or
+    //      light could be spread from blocks that are about to lose it
+    Phase phase = Phase::ADDITION;
+    for(const auto& [chunk_index, region] : m_regions)
+      if(has_removals(region))
+        phase = Phase::REMOVAL;
+
+    regions.clear();
+    for(auto& [chunk_index, region] : m_regions)
+      if(phase == Phase::REMOVAL ? has_removals(region) : has_additions(region))
+        regions.push_back(&region);
+
+    if(regions.empty() || std::chrono::steady_clock::now() >= deadline)
+      break;
+
+    // 3.3: Process every region with work left, closest to a player first
+    for(Region* region : regions)
+    {
+      glm::vec2 center = (glm::vec2(region->chunk_index) + 0.5f) * static_cast<float>(CHUNK_WIDTH);
+      region->priority = std::numeric_limits<float>::infinity();
+      for(const Player& player : world.players)
+        region->priority = std::min(region->priority, glm::distance(center, glm::vec2(world.entities.at(player.entity_id).transform.position)));
+    }
+
+    std::sort(regions.begin(), regions.end(), [](const Region* lhs, const Region* rhs) {
+      return std::tie(lhs->priority, lhs->chunk_index.x, lhs->chunk_index.y) < std::tie(rhs->priority, rhs->chunk_index.x, rhs->chunk_index.y);
+    });
+    parallel_for_each<Region>(regions, phase == Phase::REMOVAL ? process_removals : process_additions, deadline);
   }
 
-  for(glm::ivec3 update : updates)
+  /**********************
+   * 4: Invalidate mesh *
+   **********************/
+  for(auto& [chunk_index, region] : m_regions)
   {
-    invalidate_mesh(world, update + glm::ivec3(-1, 0, 0));
-    invalidate_mesh(world, update + glm::ivec3( 1, 0, 0));
-    invalidate_mesh(world, update + glm::ivec3(0, -1, 0));
-    invalidate_mesh(world, update + glm::ivec3(0,  1, 0));
-    invalidate_mesh(world, update + glm::ivec3(0, 0, -1));
-    invalidate_mesh(world, update + glm::ivec3(0, 0,  1));
+    if(region.updates & 1)
+      invalidate_mesh(*region.chunk);
+
+    for(int i=0; i<4; ++i)
+      if(region.updates & (1 << (i + 1)) && region.neighbours[i])
+        invalidate_mesh(*region.neighbours[i]);
+
+    region.updates = 0;
   }
+
+  /************************************************
+   * 5: Chunks with nothing left to do are now lit *
+   ************************************************/
+  std::erase_if(m_regions, [&](const auto& item) {
+    const Region& region = item.second;
+    for(int i=0; i<4; ++i)
+      if(!region.outboxes[static_cast<int>(Phase::REMOVAL)][i].empty() || !region.outboxes[static_cast<int>(Phase::ADDITION)][i].empty())
+        return false;
+
+    if(has_removals(region) || has_additions(region))
+      return false;
+
+    region.chunk->state = ChunkState::LIT;
+    return true;
+  });
+}
+
+void LightManager::invalidate(glm::ivec3 position)
+{
+  m_invalidations.push_back(position);
 }
 
+void LightManager::invalidate(glm::ivec2 chunk_index)
+{
+  m_chunk_invalidations.push_back(chunk_index);
+}
+
+void LightManager::update(World& world)
+{
+  run(world, std::chrono::steady_clock::time_point::max());
+}
+
+void LightManager::update(World& world, std::chrono::steady_clock::duration budget)
+{
+  run(world, std::chrono::steady_clock::now() + budget);
+}
+
+size_t LightManager::pending() const
+{
+  size_t count = m_invalidations.size();
+  for(const auto& [chunk_index, region] : m_regions)
+  {
+    count += region.removals.size() + region.additions.size();
+    for(int phase=0; phase<2; ++phase)
+    {
+      count += region.inboxes[phase].size();
+      for(int i=0; i<4; ++i)
+        count += region.outboxes[phase][i].size();
+    }
+  }
+  return count;
+}
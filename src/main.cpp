@@ -6,6 +6,7 @@
 #include <player_control.hpp>
 
 #include <graphics/camera.hpp>
+#include <graphics/profiler.hpp>
 #include <graphics/ui_renderer.hpp>
 #include <graphics/window.hpp>
 #include <graphics/wireframe_renderer.hpp>
@@ -18,13 +19,62 @@
 
 #include <resource_pack.hpp>
 
-int main()
+#include <bench_render.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <fmt/format.h>
+
+#include <experimental/scope>
+#include <stdexcept>
+
+static int usage(const char *program)
+{
+  fmt::print(stderr, "Usage: {} [--bench-render [--frames N] [--size WIDTHxHEIGHT] [--checksums FILE]]\n", program);
+  return -1;
+}
+
+int main(int argc, char *argv[])
 {
   static constexpr float FIXED_DT = 1.0f / 20.0f;
 
+  bool               bench = false;
+  BenchRenderOptions bench_options;
+  for(int i=1; i<argc; ++i)
+  {
+    std::string_view arg = argv[i];
+    if(arg == "--bench-render")
+      bench = true;
+    else if(arg == "--frames" && i+1 < argc)
+    {
+      int frames;
+      try { frames = std::stoi(argv[++i]); } catch(const std::logic_error&) { return usage(argv[0]); }
+      if(frames <= 0)
+        return usage(argv[0]);
+
+      bench_options.frames = frames;
+    }
+    else if(arg == "--size" && i+1 < argc)
+    {
+      int width, height;
+      if(std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+        return usage(argv[0]);
+
+      bench_options.width  = width;
+      bench_options.height = height;
+    }
+    else if(arg == "--checksums" && i+1 < argc)
+      bench_options.checksums = argv[++i];
+    else
+      return usage(argv[0]);
+  }
+
+  if(bench)
+    return bench_render(bench_options);
+
   World world = load_world("world");
 
-  WorldGenerator   world_generator(load_world_generation_config("world"));
+  WorldGenerator   world_generator(load_world_generation_config("world"), "world");
   LightManager     light_manager;
 
   graphics::Window            window("voxy", 1024, 720);
@@ -35,17 +85,25 @@ int main()
   WorldRenderer world_renderer(load_resource_pack("resource_pack"));
   DebugRenderer debug_renderer;
 
+  graphics::Profiler& profiler = graphics::Profiler::instance();
+  std::experimental::scope_exit profiler_exit([&profiler]() { profiler.release(); });
+
   bool third_person = false;
-  window.glfw_on_key([&third_person](int key, int scancode, int action, int mods) {
+  window.glfw_on_key([&third_person, &profiler](int key, int scancode, int action, int mods) {
     if(key == GLFW_KEY_F5 && action == GLFW_PRESS)
       third_person = !third_person;
+
+    // Dump render statistics of the last frame for external tools
+    if(key == GLFW_KEY_F3 && action == GLFW_PRESS)
+      fmt::print("{}\n", profiler.dump());
   });
 
   bool   cursor_first = false;
   double cursor_xpos;
   double cursor_ypos;
 
-  Timer timer;
+  Timer  timer;
+  double frame_time = glfwGetTime();
   for(;;)
   {
     window.poll_events();
@@ -85,10 +143,16 @@ int main()
       world_generator.update(world, light_manager);
       update_player_control(world, light_manager, FIXED_DT);
       update_physics(world, FIXED_DT);
-      light_manager.update(world);
+      light_manager.update(world, LightManager::TICK_BUDGET);
     }
 
     // 2: Rendering
+    double new_frame_time = glfwGetTime();
+    debug_renderer.update(new_frame_time - frame_time);
+    frame_time = new_frame_time;
+
+    profiler.begin_frame();
+
     const Player& player        = world.players.front();
     const Entity& player_entity = world.entities.at(player.entity_id);
     camera.transform            =  player_entity.transform;
@@ -106,8 +170,14 @@ int main()
     glViewport(0, 0, width, height);
 
     world_renderer.render(camera, world, third_person, wireframer_renderer);
+
+    profiler.begin(graphics::Pass::WIREFRAME);
     render_player_ui(camera, world, wireframer_renderer);
-    debug_renderer.render(glm::vec2(width, height), world, ui_renderer);
+    profiler.end(graphics::Pass::WIREFRAME);
+
+    profiler.begin(graphics::Pass::UI);
+    debug_renderer.render(glm::vec2(width, height), world, light_manager, ui_renderer);
+    profiler.end(graphics::Pass::UI);
 
     window.swap_buffers();
   }
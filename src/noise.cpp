@@ -0,0 +1,316 @@
+#include <noise.hpp>
+
+#include <yaml-cpp/yaml.h>
+
+#include <vector>
+
+#include <string.h>
+
+// Kernels are compiled once per instruction set and picked at load time. Lanes
+// are written with GCC vector extensions, which lower to 8-wide AVX2 in the
+// avx2 clone and to pairs of 4-wide SSE operations in the default one.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define NOISE_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define NOISE_TARGET_CLONES
+#endif
+
+// Helpers below pass vectors by value, but all of them are internal and inlined
+// into the kernels, so which registers would be used to do so does not matter.
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace
+{
+  using Lanes = float __attribute__((vector_size(32)));
+  static constexpr unsigned LANE_COUNT = sizeof(Lanes) / sizeof(float);
+
+  inline Lanes load(const float *p)
+  {
+    Lanes value;
+    memcpy(&value, p, sizeof value);
+    return value;
+  }
+
+  inline void store(float *p, const Lanes& value)
+  {
+    memcpy(p, &value, sizeof value);
+  }
+
+  // Sample positions along one axis for one octave, together with the lattice
+  // nodes they fall between.
+  struct Axis
+  {
+    int      node_min;
+    unsigned node_count;
+
+    std::vector<unsigned> nodes;    // Lower node of each sample, relative to node_min
+    std::vector<float>    offsets0; // Offset of each sample from its lower node
+    std::vector<float>    offsets1; // Offset of each sample from its upper node
+    std::vector<float>    fades;
+  };
+
+  Axis make_axis(float origin, float step, unsigned size, float frequency)
+  {
+    std::vector<int> nodes(size);
+    std::vector<float> positions(size);
+    for(unsigned i=0; i<size; ++i)
+    {
+      positions[i] = (origin + i * step) * frequency;
+      nodes[i]     = glm::floor(positions[i]);
+    }
+
+    Axis axis;
+    axis.node_min   = std::min(nodes.front(), nodes.back());
+    axis.node_count = std::max(nodes.front(), nodes.back()) - axis.node_min + 2;
+    axis.nodes   .resize(size);
+    axis.offsets0.resize(size);
+    axis.offsets1.resize(size);
+    axis.fades   .resize(size);
+    for(unsigned i=0; i<size; ++i)
+    {
+      axis.nodes[i]    = nodes[i] - axis.node_min;
+      axis.offsets0[i] = positions[i] - static_cast<float>(nodes[i]);
+      axis.offsets1[i] = positions[i] - static_cast<float>(nodes[i] + 1);
+      axis.fades[i]    = details::perlin_fade(positions[i] - nodes[i]);
+    }
+    return axis;
+  }
+
+  // Gradients of the corners along a row of samples, gathered into separate
+  // arrays per corner and component so that the kernels only do arithmetic.
+  template<unsigned CORNERS, unsigned COMPONENTS>
+  struct Gathered
+  {
+    std::vector<float> values[CORNERS][COMPONENTS];
+
+    explicit Gathered(unsigned count)
+    {
+      for(auto& corner : values)
+        for(auto& component : corner)
+          component.resize(count);
+    }
+  };
+
+  inline float lerp(float a, float b, float t)
+  {
+    return a + (b - a) * t;
+  }
+
+  inline Lanes lerp(const Lanes& a, const Lanes& b, const Lanes& t)
+  {
+    return a + (b - a) * t;
+  }
+
+  /******
+   * 2D *
+   ******/
+  // Corners are indexed as x | y << 1. The order of operations mirrors
+  // perlin_hashed() exactly, so that results agree with it.
+  NOISE_TARGET_CLONES
+  void kernel2(const Axis& x_axis, float oy0, float oy1, float v, const Gathered<4, 2>& g, float amplitude, float *out)
+  {
+    const unsigned count = x_axis.nodes.size();
+    const float   *ox0   = x_axis.offsets0.data();
+    const float   *ox1   = x_axis.offsets1.data();
+    const float   *u     = x_axis.fades.data();
+
+    unsigned i = 0;
+    for(; i + LANE_COUNT <= count; i += LANE_COUNT)
+    {
+      Lanes lox0 = load(ox0 + i), lox1 = load(ox1 + i), lu = load(u + i);
+      Lanes n00  = load(&g.values[0][0][i]) * lox0 + load(&g.values[0][1][i]) * oy0;
+      Lanes n10  = load(&g.values[1][0][i]) * lox1 + load(&g.values[1][1][i]) * oy0;
+      Lanes n01  = load(&g.values[2][0][i]) * lox0 + load(&g.values[2][1][i]) * oy1;
+      Lanes n11  = load(&g.values[3][0][i]) * lox1 + load(&g.values[3][1][i]) * oy1;
+      Lanes lv   = Lanes{} + v;
+      Lanes a    = lerp(n00, n01, lv);
+      Lanes b    = lerp(n10, n11, lv);
+      store(out + i, load(out + i) + lerp(a, b, lu) * amplitude);
+    }
+    for(; i < count; ++i)
+    {
+      float n00 = g.values[0][0][i] * ox0[i] + g.values[0][1][i] * oy0;
+      float n10 = g.values[1][0][i] * ox1[i] + g.values[1][1][i] * oy0;
+      float n01 = g.values[2][0][i] * ox0[i] + g.values[2][1][i] * oy1;
+      float n11 = g.values[3][0][i] * ox1[i] + g.values[3][1][i] * oy1;
+      float a   = lerp(n00, n01, v);
+      float b   = lerp(n10, n11, v);
+      out[i] += lerp(a, b, u[i]) * amplitude;
+    }
+  }
+
+  void perlin_grid(size_t seed, glm::vec2 origin, glm::vec2 step, glm::uvec2 size, float frequency, float amplitude, float *out)
+  {
+    std::uint32_t hashed_seed = details::hash_seed(seed);
+
+    Axis x_axis = make_axis(origin.x, step.x, size.x, frequency);
+    Axis y_axis = make_axis(origin.y, step.y, size.y, frequency);
+
+    std::vector<glm::vec2> gradients(x_axis.node_count * y_axis.node_count);
+    for(unsigned y=0; y<y_axis.node_count; ++y)
+      for(unsigned x=0; x<x_axis.node_count; ++x)
+        gradients[y * x_axis.node_count + x] = details::perlin_gradient_hashed(hashed_seed, glm::ivec2(x_axis.node_min + x, y_axis.node_min + y));
+
+    Gathered<4, 2> gathered(size.x);
+    for(unsigned j=0; j<size.y; ++j)
+    {
+      for(unsigned i=0; i<size.x; ++i)
+        for(unsigned corner=0; corner<4; ++corner)
+        {
+          unsigned x = x_axis.nodes[i] + (corner & 1);
+          unsigned y = y_axis.nodes[j] + (corner >> 1 & 1);
+          glm::vec2 gradient = gradients[y * x_axis.node_count + x];
+          gathered.values[corner][0][i] = gradient.x;
+          gathered.values[corner][1][i] = gradient.y;
+        }
+
+      kernel2(x_axis, y_axis.offsets0[j], y_axis.offsets1[j], y_axis.fades[j], gathered, amplitude, out + j * size.x);
+    }
+  }
+
+  /******
+   * 3D *
+   ******/
+  // Corners are indexed as x | y << 1 | z << 2.
+  NOISE_TARGET_CLONES
+  void kernel3(const Axis& x_axis, float oy0, float oy1, float v, float oz0, float oz1, float w, const Gathered<8, 3>& g, float amplitude, float *out)
+  {
+    const unsigned count = x_axis.nodes.size();
+    const float   *ox0   = x_axis.offsets0.data();
+    const float   *ox1   = x_axis.offsets1.data();
+    const float   *u     = x_axis.fades.data();
+
+    unsigned i = 0;
+    for(; i + LANE_COUNT <= count; i += LANE_COUNT)
+    {
+      Lanes lox0 = load(ox0 + i), lox1 = load(ox1 + i), lu = load(u + i);
+      Lanes n[8];
+      for(unsigned corner=0; corner<8; ++corner)
+      {
+        Lanes ox = corner & 1      ? lox1 : lox0;
+        float oy = corner >> 1 & 1 ? oy1  : oy0;
+        float oz = corner >> 2 & 1 ? oz1  : oz0;
+        n[corner] = load(&g.values[corner][0][i]) * ox + load(&g.values[corner][1][i]) * oy + load(&g.values[corner][2][i]) * oz;
+      }
+      Lanes lv = Lanes{} + v;
+      Lanes lw = Lanes{} + w;
+      Lanes a  = lerp(lerp(n[0], n[4], lw), lerp(n[2], n[6], lw), lv);
+      Lanes b  = lerp(lerp(n[1], n[5], lw), lerp(n[3], n[7], lw), lv);
+      store(out + i, load(out + i) + lerp(a, b, lu) * amplitude);
+    }
+    for(; i < count; ++i)
+    {
+      float n[8];
+      for(unsigned corner=0; corner<8; ++corner)
+      {
+        float ox = corner & 1      ? ox1[i] : ox0[i];
+        float oy = corner >> 1 & 1 ? oy1    : oy0;
+        float oz = corner >> 2 & 1 ? oz1    : oz0;
+        n[corner] = g.values[corner][0][i] * ox + g.values[corner][1][i] * oy + g.values[corner][2][i] * oz;
+      }
+      float a = lerp(lerp(n[0], n[4], w), lerp(n[2], n[6], w), v);
+      float b = lerp(lerp(n[1], n[5], w), lerp(n[3], n[7], w), v);
+      out[i] += lerp(a, b, u[i]) * amplitude;
+    }
+  }
+
+  void perlin_grid(size_t seed, glm::vec3 origin, glm::vec3 step, glm::uvec3 size, float frequency, float amplitude, float *out)
+  {
+    std::uint32_t hashed_seed = details::hash_seed(seed);
+
+    Axis x_axis = make_axis(origin.x, step.x, size.x, frequency);
+    Axis y_axis = make_axis(origin.y, step.y, size.y, frequency);
+    Axis z_axis = make_axis(origin.z, step.z, size.z, frequency);
+
+    std::vector<glm::vec3> gradients(x_axis.node_count * y_axis.node_count * z_axis.node_count);
+    for(unsigned z=0; z<z_axis.node_count; ++z)
+      for(unsigned y=0; y<y_axis.node_count; ++y)
+        for(unsigned x=0; x<x_axis.node_count; ++x)
+          gradients[(z * y_axis.node_count + y) * x_axis.node_count + x] = details::perlin_gradient_hashed(hashed_seed, glm::ivec3(x_axis.node_min + x, y_axis.node_min + y, z_axis.node_min + z));
+
+    Gathered<8, 3> gathered(size.x);
+    for(unsigned k=0; k<size.z; ++k)
+      for(unsigned j=0; j<size.y; ++j)
+      {
+        for(unsigned i=0; i<size.x; ++i)
+          for(unsigned corner=0; corner<8; ++corner)
+          {
+            unsigned x = x_axis.nodes[i] + (corner & 1);
+            unsigned y = y_axis.nodes[j] + (corner >> 1 & 1);
+            unsigned z = z_axis.nodes[k] + (corner >> 2 & 1);
+            glm::vec3 gradient = gradients[(z * y_axis.node_count + y) * x_axis.node_count + x];
+            gathered.values[corner][0][i] = gradient.x;
+            gathered.values[corner][1][i] = gradient.y;
+            gathered.values[corner][2][i] = gradient.z;
+          }
+
+        kernel3(x_axis,
+            y_axis.offsets0[j], y_axis.offsets1[j], y_axis.fades[j],
+            z_axis.offsets0[k], z_axis.offsets1[k], z_axis.fades[k],
+            gathered, amplitude, out + (k * size.y + j) * size.x);
+      }
+  }
+
+  template<glm::length_t L>
+  void noise_grid_impl(size_t seed, glm::vec<L, float> origin, glm::vec<L, float> step, glm::vec<L, unsigned> size, NoiseConfig config, float *out)
+  {
+    size_t count = 1;
+    for(glm::length_t i=0; i<L; ++i)
+      count *= size[i];
+
+    if(count == 0)
+      return;
+
+    // Legacy gradients are too expensive for batching to matter, and must stay
+    // bit-exact, so simply sample them one by one.
+    if(config.version == NoiseVersion::LEGACY)
+    {
+      for(size_t n=0; n<count; ++n)
+      {
+        glm::vec<L, float> position = origin;
+        size_t index = n;
+        for(glm::length_t i=0; i<L; ++i)
+        {
+          position[i] += (index % size[i]) * step[i];
+          index /= size[i];
+        }
+        out[n] = noise(seed, position, config);
+      }
+      return;
+    }
+
+    for(size_t n=0; n<count; ++n)
+      out[n] = 0.0f;
+
+    float frequency = config.frequency;
+    float amplitude = config.amplitude;
+    for(unsigned i=0; i<config.octaves; ++i)
+    {
+      perlin_grid(seed + i, origin, step, size, frequency, amplitude, out);
+      frequency *= config.lacunarity;
+      amplitude *= config.persistence;
+    }
+  }
+}
+
+void noise_grid(size_t seed, glm::vec2 origin, glm::vec2 step, glm::uvec2 size, NoiseConfig config, float *out)
+{
+  noise_grid_impl<2>(seed, origin, step, size, config, out);
+}
+
+void noise_grid(size_t seed, glm::vec3 origin, glm::vec3 step, glm::uvec3 size, NoiseConfig config, float *out)
+{
+  noise_grid_impl<3>(seed, origin, step, size, config, out);
+}
+
+NoiseConfig load_noise_config(const YAML::Node& node, NoiseVersion version)
+{
+  NoiseConfig config;
+  config.version     = version;
+  config.frequency   = node["frequency"]  .as<float>();
+  config.amplitude   = node["amplitude"]  .as<float>();
+  config.lacunarity  = node["lacunarity"] .as<float>();
+  config.persistence = node["persistence"].as<float>();
+  config.octaves     = node["octaves"]    .as<unsigned>();
+  return config;
+}
@@ -1,11 +1,27 @@
 #include <physics.hpp>
 
+#include <coordinates.hpp>
+
+#include <algorithm>
 #include <optional>
+#include <unordered_map>
+
+#include <assert.h>
 
 static constexpr float FRICTION_AIR      = 0.03f;
 static constexpr float FRICTION_GROUNDED = 0.05f;
 static constexpr float GRAVITY           = 9.8f;
 
+static constexpr float CONTACT_EPSILON   = 1e-3f;
+static constexpr float ENTITY_PUSH_SPEED = 1.0f; // Speed at which overlapping entities are pushed apart
+
+static constexpr float SLEEP_SPEED = 0.05f; // Horizontal speed below which a supported entity is at rest
+static constexpr float SLEEP_DELAY = 1.0f;  // Time an entity has to be at rest for before it falls asleep
+
+static constexpr float    LOD_DISTANCE      = CHUNK_WIDTH;       // Distance from players past which entities are moved half as often
+static constexpr unsigned LOD_MAX_LEVEL     = 3;                 // Entities are moved at least every 2^3 = 8 ticks
+static constexpr int      SIMULATION_RADIUS = CHUNK_LOAD_RADIUS; // Chunks around players in which entities are moved at all
+
 struct SweptAABBResult
 {
   float t_in;  glm::vec3 normal_in;
@@ -56,67 +72,542 @@ static std::optional<SweptAABBResult> swept_aabb(AABB box1, AABB box2, glm::vec3
   return result;
 }
 
-static void entity_update_physics(const World& world, Entity& entity, float dt)
+// Sweep box1 by direction against box2, and return where they come into contact
+// if they do so within the sweep. Boxes that already overlap by no more than
+// rounding errors could account for, such as an entity resting on another one
+// after having been stopped by it, are in contact from the start.
+static std::optional<SweptAABBResult> sweep(AABB box1, AABB box2, glm::vec3 direction)
+{
+  std::optional<SweptAABBResult> result = swept_aabb(box1, box2, direction);
+  if(!result || result->t_in > 1.0f)
+    return std::nullopt;
+
+  if(result->t_in < 0.0f)
+  {
+    if(result->t_out <= 0.0f || -result->t_in * std::abs(glm::dot(direction, result->normal_in)) > CONTACT_EPSILON)
+      return std::nullopt;
+
+    result->t_in = 0.0f;
+  }
+  return result;
+}
+
+// Friction and gravity are applied directly rather than through
+// entity_apply_force(), which would count as being pushed around and keep the
+// entity from ever falling asleep
+static void entity_apply_forces(Entity& entity, float dt)
 {
   float friction = entity.grounded ? FRICTION_GROUNDED : FRICTION_AIR;
-  entity_apply_force(entity, -friction * entity.velocity,        dt);
-  entity_apply_force(entity, -GRAVITY  * glm::vec3(0.0f, 0.0f, 1.0f), dt);
+  entity.velocity += dt * -friction * entity.velocity;
+  entity.velocity += dt * -GRAVITY  * glm::vec3(0.0f, 0.0f, 1.0f);
+}
+
+// Looks up whether voxels are solid through the chunk they are in, which is
+// kept around for the next lookup, since voxels looked up one after another
+// are almost always in the same chunk. Voxels in chunks that are not loaded
+// and voxels above or below the world are not solid.
+class VoxelLookup
+{
+public:
+  explicit VoxelLookup(const World& world) : m_world(world) {}
+
+  bool is_solid(glm::ivec3 position)
+  {
+    if(position.z < 0 || position.z >= CHUNK_HEIGHT)
+      return false;
+
+    auto [local_position, chunk_index] = coordinates::split(position);
+    if(!m_found || chunk_index != m_chunk_index)
+    {
+      auto it = m_world.chunks.find(chunk_index);
+      m_chunk       = it != m_world.chunks.end() ? &it->second : nullptr;
+      m_chunk_index = chunk_index;
+      m_found       = true;
+    }
+    return m_chunk && m_chunk->blocks[local_position.z][local_position.y][local_position.x].id != BLOCK_ID_NONE;
+  }
+
+private:
+  const World& m_world;
+  const Chunk* m_chunk = nullptr;
+  glm::ivec2   m_chunk_index;
+  bool         m_found = false;
+};
+
+// Cut short motion of an entity by direction wherever it runs into a voxel.
+//
+// The entity is moved along one axis at a time, vertical first. Along each
+// axis, only the layers of voxels its leading face passes through are looked
+// at, nearest first, and only as far across as the entity is wide, so that
+// finding the first solid voxel in the way takes neither allocating nor
+// sorting anything. Voxels the entity merely touches on its sides are not in
+// the way.
+static glm::vec3 entity_sweep_voxels(const World& world, Entity& entity, glm::vec3 direction)
+{
+  VoxelLookup lookup(world);
+
+  AABB aabb = entity_get_aabb(entity);
+  for(int axis : {2, 0, 1})
+  {
+    float distance = direction[axis];
+    if(distance == 0.0f)
+      continue;
+
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+
+    int u_begin = std::floor(aabb.position[u]                     + CONTACT_EPSILON);
+    int u_end   = std::floor(aabb.position[u] + aabb.dimension[u] - CONTACT_EPSILON);
+    int v_begin = std::floor(aabb.position[v]                     + CONTACT_EPSILON);
+    int v_end   = std::floor(aabb.position[v] + aabb.dimension[v] - CONTACT_EPSILON);
+
+    // Layers whose near face lies between the leading face of the entity,
+    // less what rounding errors could account for, and where it is headed
+    int   step = distance > 0.0f ? 1 : -1;
+    float face = distance > 0.0f ? aabb.position[axis] + aabb.dimension[axis] : aabb.position[axis];
+    int   begin, end;
+    if(distance > 0.0f)
+    {
+      begin = std::ceil(face - CONTACT_EPSILON);
+      end   = std::ceil(face + distance);
+    }
+    else
+    {
+      begin = std::floor(face + CONTACT_EPSILON) - 1;
+      end   = std::floor(face + distance) - 1;
+    }
+
+    for(int n = 0; n < step * (end - begin); ++n)
+    {
+      int layer = begin + n * step;
+
+      bool solid = false;
+      for(int j = v_begin; j <= v_end && !solid; ++j)
+        for(int i = u_begin; i <= u_end && !solid; ++i)
+        {
+          glm::ivec3 position;
+          position[axis] = layer;
+          position[u]    = i;
+          position[v]    = j;
+          solid = lookup.is_solid(position);
+        }
+
+      if(solid)
+      {
+        float near_face = distance > 0.0f ? layer : layer + 1;
+        distance = distance > 0.0f ? std::max(near_face - face, 0.0f) : std::min(near_face - face, 0.0f);
+
+        entity.velocity[axis] = 0.0f;
+        entity.collided = true;
+        if(axis == 2 && step < 0)
+          entity.grounded = true;
+        break;
+      }
+    }
+
+    aabb.position[axis] += distance;
+    direction[axis]      = distance;
+  }
+  return direction;
+}
+
+// Cut short motion of two entities by their directions where they run into
+// each other, and have them share their momentum from then on. An entity that
+// is not being moved this tick does not budge, which leaves it to the entity
+// running into it to give way entirely. Return true if any motion has been cut
+// short.
+static bool entity_sweep_entity(Entity& entity1, glm::vec3& direction1, bool moving1, Entity& entity2, glm::vec3& direction2, bool moving2)
+{
+  AABB aabb1 = entity_get_aabb(entity1);
+  AABB aabb2 = entity_get_aabb(entity2);
+
+  float share1 = !moving1 ? 0.0f : !moving2 ? 1.0f : 0.5f;
+  float share2 = 1.0f - share1;
+
+  // Entities that already overlap, most likely because one of them was held
+  // back by a voxel after the other had been stopped against it, are pushed
+  // apart sideways along the axis they overlap the least in
+  glm::vec3 overlap = glm::min(aabb1.position + aabb1.dimension, aabb2.position + aabb2.dimension) - glm::max(aabb1.position, aabb2.position);
+  if(overlap.x > CONTACT_EPSILON && overlap.y > CONTACT_EPSILON && overlap.z > CONTACT_EPSILON)
+  {
+    int       axis   = overlap.x <= overlap.y ? 0 : 1;
+    glm::vec3 normal = {};
+    normal[axis] = entity1.transform.position[axis] <= entity2.transform.position[axis] ? -1.0f : 1.0f;
+
+    float speed = glm::dot(entity1.velocity - entity2.velocity, normal);
+    if(speed < ENTITY_PUSH_SPEED)
+    {
+      entity1.velocity += share1 * (ENTITY_PUSH_SPEED - speed) * normal;
+      entity2.velocity -= share2 * (ENTITY_PUSH_SPEED - speed) * normal;
+    }
+    return false;
+  }
+
+  std::optional<SweptAABBResult> result = sweep(aabb1, aabb2, direction1 - direction2);
+  if(!result || result->t_in >= result->t_out)
+    return false;
+
+  // Normal of the face of the second entity that the first one runs into
+  glm::vec3 normal = result->normal_in;
+
+  if(glm::dot(direction1, normal) < 0.0f) direction1 -= glm::dot(direction1, normal) * normal * (1.0f - result->t_in);
+  if(glm::dot(direction2, normal) > 0.0f) direction2 -= glm::dot(direction2, normal) * normal * (1.0f - result->t_in);
+
+  float speed = glm::dot(entity1.velocity - entity2.velocity, normal);
+  if(speed < 0.0f)
+  {
+    entity1.velocity -= share1 * speed * normal;
+    entity2.velocity += share2 * speed * normal;
+  }
+
+  entity1.collided = true;
+  entity2.collided = true;
+  if(normal.z > 0.0f) entity1.grounded = true;
+  if(normal.z < 0.0f) entity2.grounded = true;
+  return true;
+}
+
+static bool entity_touch_entity(const Entity& entity1, const Entity& entity2)
+{
+  AABB aabb1 = entity_get_aabb(entity1);
+  AABB aabb2 = entity_get_aabb(entity2);
+
+  glm::vec3 overlap = glm::min(aabb1.position + aabb1.dimension, aabb2.position + aabb2.dimension) - glm::max(aabb1.position, aabb2.position);
+  return overlap.x >= -CONTACT_EPSILON && overlap.y >= -CONTACT_EPSILON && overlap.z >= -CONTACT_EPSILON;
+}
+
+// Number of ticks between updates of an entity, which doubles with every
+// LOD_DISTANCE away from the closest player, or 0 if the entity is frozen in
+// place because it is in a chunk that is not loaded or too far away from any
+// player for anyone to notice. Without players, every loaded entity is moved
+// every tick.
+static glm::ivec2 entity_chunk_index(const Entity& entity)
+{
+  return glm::floor(glm::vec2(entity.transform.position) / static_cast<float>(CHUNK_WIDTH));
+}
+
+static unsigned entity_tick_period(const World& world, const Entity& entity)
+{
+  glm::ivec2 chunk_index = entity_chunk_index(entity);
+  if(!world.chunks.contains(chunk_index))
+    return 0;
+
+  if(world.players.empty())
+    return 1;
 
-  AABB entity_aabb = entity_get_aabb(entity);
-  glm::vec3 direction = dt * entity.velocity;
+  bool  simulated = false;
+  float distance  = std::numeric_limits<float>::infinity();
+  for(const Player& player : world.players)
+  {
+    const Entity& player_entity = world.entities[player.entity_id];
+
+    glm::ivec2 offset = chunk_index - entity_chunk_index(player_entity);
+    simulated = simulated || offset.x * offset.x + offset.y * offset.y <= SIMULATION_RADIUS * SIMULATION_RADIUS;
+    distance  = std::min(distance, glm::distance(glm::vec2(entity.transform.position), glm::vec2(player_entity.transform.position)));
+  }
+
+  if(!simulated)
+    return 0;
+
+  unsigned level = std::min(static_cast<unsigned>(distance / LOD_DISTANCE), LOD_MAX_LEVEL);
+  return 1u << level;
+}
+
+// Put frozen entities in the chunk back to be moved again, if the chunk is
+// loaded by now
+static void thaw_entities(World& world, glm::ivec2 chunk_index)
+{
+  auto it = world.frozen_entities.find(chunk_index);
+  if(it == world.frozen_entities.end() || !world.chunks.contains(chunk_index))
+    return;
+
+  for(std::uint32_t entity_id : it->second)
+  {
+    world.entities[entity_id].frozen = false;
+    world.awake_entities.push_back(entity_id);
+  }
+  world.frozen_entities.erase(it);
+}
+
+static std::uint32_t find(std::vector<std::uint32_t>& parents, std::uint32_t i)
+{
+  while(parents[i] != i)
+    i = parents[i] = parents[parents[i]];
+  return i;
+}
 
-  glm::vec3 corner1 = entity_aabb.position                                    ;
-  glm::vec3 corner2 = entity_aabb.position                         + direction;
-  glm::vec3 corner3 = entity_aabb.position + entity_aabb.dimension            ;
-  glm::vec3 corner4 = entity_aabb.position + entity_aabb.dimension + direction;
+// Entities are moved in phases. Phases that only read voxels and write to the
+// entity they work on run in parallel, and anything involving several entities
+// at once runs serially in order of their index, so that the outcome does not
+// depend on the number of threads.
+//
+// Entities that have been supported and nearly still for a while fall asleep,
+// and are left alone until they are pushed around, until a block next to them
+// changes, or until anything touching them starts moving. Entities touching
+// each other form an island, which only falls asleep as a whole, so that an
+// entity never gets left hanging in the air by one it rests upon. Sleeping
+// entities stay in the spatial hash where they fell asleep, and are only ever
+// looked at through entities around them that are awake, so that they cost
+// nothing at all.
+//
+// Entities further away from players are moved less often, every 2nd, 4th or
+// 8th tick, by all the time that has passed since they were last moved. Ticks
+// on which they are moved are staggered by their index so that the work is
+// spread out evenly. Entities not moved on a tick are left alone just like
+// sleeping ones.
+//
+// Entities in chunks far enough away from every player are frozen in place
+// altogether, as are entities in chunks that are not loaded, which would
+// otherwise fall through the world. Frozen entities are set aside by chunk,
+// and only the chunks within reach of players are looked up to bring them
+// back, so that the cost of a tick depends on what is going on around players
+// rather than on the number of entities.
+void update_physics(World& world, float dt)
+{
+  const std::uint64_t tick = world.physics_ticks++;
 
-  glm::ivec3 corner_min = glm::floor(glm::min(glm::min(glm::min(corner1, corner2), corner3), corner4));
-  glm::ivec3 corner_max = glm::ceil (glm::max(glm::max(glm::max(corner1, corner2), corner3), corner4));
+  // 0: Pick up entities added since the last update. Entities are never
+  //    removed, other than all of them at once along with the spatial hash and
+  //    the list of awake entities.
+  assert(world.entity_hash.size() <= world.entities.size());
+  for(size_t i=world.entity_hash.size(); i<world.entities.size(); ++i)
+  {
+    world.entity_hash.insert(entity_get_aabb(world.entities[i]));
+    if(!world.entities[i].sleeping)
+      world.awake_entities.push_back(i);
+  }
 
-  struct Item
+  // Bring back frozen entities that are within reach of a player again, or
+  // anywhere loaded without players
+  if(!world.frozen_entities.empty())
   {
-    glm::ivec3 position;
-    float      distance;
+    if(world.players.empty())
+    {
+      std::vector<glm::ivec2> chunk_indices;
+      for(const auto& [chunk_index, entity_ids] : world.frozen_entities)
+        if(world.chunks.contains(chunk_index))
+          chunk_indices.push_back(chunk_index);
+
+      for(glm::ivec2 chunk_index : chunk_indices)
+        thaw_entities(world, chunk_index);
+    }
+    else
+      for(const Player& player : world.players)
+      {
+        glm::ivec2 player_chunk_index = entity_chunk_index(world.entities[player.entity_id]);
+        for(int dy = -SIMULATION_RADIUS; dy <= SIMULATION_RADIUS; ++dy)
+          for(int dx = -SIMULATION_RADIUS; dx <= SIMULATION_RADIUS; ++dx)
+            if(dx * dx + dy * dy <= SIMULATION_RADIUS * SIMULATION_RADIUS)
+              thaw_entities(world, player_chunk_index + glm::ivec2(dx, dy));
+      }
+  }
+
+  // Nothing moves while everything is asleep, and everything else goes in
+  // order of index no matter in which order entities were woken up
+  std::vector<std::uint32_t>& awake = world.awake_entities;
+  if(awake.empty())
+    return;
+
+  std::sort(awake.begin(), awake.end());
+
+  const size_t count = awake.size();
+  auto slot = [&](std::uint32_t entity_id) -> size_t {
+    return std::lower_bound(awake.begin(), awake.end(), entity_id) - awake.begin();
   };
-  std::vector<Item> items;
-
-  // We store all voxel that may be in our path and sort them by distance.
-  // The idea comes from the video - Arbitrary Rectangle Collision Detection &
-  // Resolution - Complete! by javidx9 at
-  // https://www.youtube.com/watch?v=8JJ-4JgR7Dg.
-  for(int z = corner_min.z; z<=corner_max.z; ++z)
-    for(int y = corner_min.y; y<=corner_max.y; ++y)
-      for(int x = corner_min.x; x<=corner_max.x; ++x)
-        items.push_back(Item{
-          .position = glm::ivec3(x, y, z),
-          .distance = glm::length(glm::vec3(x, y, z) - entity.transform.position),
-        });
-
-  std::sort(items.begin(), items.end(), [](const Item& lhs, const Item& rhs) { return lhs.distance < rhs.distance; });
-
-  for(const Item& item : items)
+
+  // 1: Pick entities to move this tick, move them against voxels, and work out
+  //    the space each of them sweeps through
+  std::vector<glm::vec3>    directions(count);
+  std::vector<AABB>         aabbs(count);
+  std::vector<std::uint8_t> moving(count);
+  std::vector<std::uint8_t> falling(count);
+  std::vector<std::uint8_t> frozen(count);
+  std::vector<float>        dts(count);
+
+  #pragma omp parallel for schedule(dynamic, 256)
+  for(size_t k=0; k<count; ++k)
   {
-    if(const Block* block = get_block(world, item.position); block && block->id != BLOCK_ID_NONE)
+    Entity& entity = world.entities[awake[k]];
+    if(unsigned period = entity_tick_period(world, entity); period != 0)
     {
-      AABB block_aabb  = { .position = item.position,             .dimension = glm::vec3(1.0f),     };
-      if(std::optional<SweptAABBResult> result = swept_aabb(entity_aabb, block_aabb, direction))
-        if(0.0f <= result->t_in && result->t_in <= 1.0f)
-        {
-          direction       -= glm::dot(direction,       result->normal_in) * result->normal_in * (1.0f - result->t_in);
-          entity.velocity -= glm::dot(entity.velocity, result->normal_in) * result->normal_in;
+      entity.pending_time += dt;
+      if((tick + awake[k]) % period == 0)
+      {
+        moving[k] = true;
+        dts[k]    = entity.pending_time;
+        entity.pending_time = 0.0f;
+
+        entity_apply_forces(entity, dts[k]);
+        falling[k]    = entity.velocity.z < 0.0f;
+        directions[k] = entity_sweep_voxels(world, entity, dts[k] * entity.velocity);
+      }
+    }
+    else
+      frozen[k] = true;
+
+    AABB aabb = entity_get_aabb(entity);
+    aabbs[k].position  = glm::min(aabb.position, aabb.position + directions[k]);
+    aabbs[k].dimension = aabb.dimension + glm::abs(directions[k]);
+  }
+
+  // 2: Broadphase over the space swept by each entity
+  for(size_t k=0; k<count; ++k)
+    world.entity_hash.update(awake[k], aabbs[k]);
+
+  // 3: Move entities against each other, and find islands of entities touching
+  //    each other. Entities not moving this tick are only found from entities
+  //    around them that are. Cutting motion short along one axis may lead
+  //    somewhere the voxel sweep never looked at, so entities that have been
+  //    cut short are swept again.
+  //
+  //    Islands are found through union-find over awake entities, in the same
+  //    order, followed by sleeping entities as they are found.
+  std::vector<std::uint8_t>  resweeps(count);
+  std::vector<std::uint32_t> nodes(awake.begin(), awake.end());
+  std::vector<std::uint32_t> parents(count);
+  for(size_t k=0; k<count; ++k)
+    parents[k] = k;
 
-          entity.collided = true;
-          if(result->normal_in.z > 0.0f)
-            entity.grounded = true;
+  std::unordered_map<std::uint32_t, std::uint32_t> sleeping_nodes;
+  auto node = [&](std::uint32_t entity_id, size_t k) -> std::uint32_t {
+    if(k != count)
+      return k;
+
+    auto [it, inserted] = sleeping_nodes.try_emplace(entity_id, nodes.size());
+    if(inserted)
+    {
+      nodes.push_back(entity_id);
+      parents.push_back(it->second);
+    }
+    return it->second;
+  };
+
+  for(size_t k=0; k<count; ++k)
+    if(moving[k])
+    {
+      std::uint32_t i = awake[k];
+      world.entity_hash.query(aabbs[k], [&](std::uint32_t j) {
+        if(j == i)
+          return;
+
+        // Sleeping and frozen entities have no slot, and nowhere to go
+        size_t    l     = world.entities[j].sleeping || world.entities[j].frozen ? count : slot(j);
+        bool      moves = l != count && moving[l];
+        glm::vec3 still = glm::vec3(0.0f);
+        if(j < i && moves)
+          return;
+
+        if(entity_sweep_entity(world.entities[i], directions[k], true, world.entities[j], l != count ? directions[l] : still, moves))
+        {
+          resweeps[k] = true;
+          if(l != count)
+            resweeps[l] = true;
         }
+        else if(!entity_touch_entity(world.entities[i], world.entities[j]))
+          return;
+
+        std::uint32_t n = node(j, l);
+        parents[find(parents, k)] = find(parents, n);
+      });
+    }
+
+  // 4: Commit
+  #pragma omp parallel for schedule(dynamic, 256)
+  for(size_t k=0; k<count; ++k)
+  {
+    Entity& entity = world.entities[awake[k]];
+    if(!moving[k])
+      continue;
+
+    if(resweeps[k])
+      directions[k] = entity_sweep_voxels(world, entity, directions[k]);
+    entity.transform.position += directions[k];
+
+    bool supported = falling[k] && directions[k].z == 0.0f;
+    bool still     = glm::length(glm::vec2(entity.velocity)) < SLEEP_SPEED;
+    entity.rest_time = supported && still ? entity.rest_time + dts[k] : 0.0f;
+  }
+
+  // 5: Islands with anything moving in them wake up as a whole, and islands
+  //    that have been at rest for long enough fall asleep as a whole. Only
+  //    entities moved this tick have a say in either. Entities falling asleep
+  //    are left in the spatial hash where they ended up, as are entities
+  //    frozen this tick.
+  struct Island
+  {
+    bool moving = false;
+    bool rested = true;
+  };
+
+  std::vector<Island> islands(nodes.size());
+  for(size_t k=0; k<count; ++k)
+  {
+    const Entity& entity = world.entities[awake[k]];
+    if(!moving[k])
+      continue;
+
+    Island& island = islands[find(parents, k)];
+    island.moving = island.moving || entity.rest_time == 0.0f;
+    island.rested = island.rested && entity.rest_time >= SLEEP_DELAY;
+  }
+
+  bool parked = false;
+  for(size_t n=0; n<nodes.size(); ++n)
+  {
+    Entity&       entity = world.entities[nodes[n]];
+    const Island& island = islands[find(parents, n)];
+    if(island.moving && entity.sleeping)
+      entity_wake(world, nodes[n]);
+    else if(island.rested && n < count && moving[n])
+    {
+      entity.sleeping = true;
+      entity.velocity = glm::vec3(0.0f);
+      world.entity_hash.update(nodes[n], entity_get_aabb(entity));
+      parked = true;
     }
   }
 
-  entity.transform.position += direction;
+  // 6: Set entities frozen this tick aside until a player comes close
+  for(size_t k=0; k<count; ++k)
+    if(frozen[k])
+    {
+      Entity& entity = world.entities[awake[k]];
+      entity.frozen = true;
+      world.frozen_entities[entity_chunk_index(entity)].push_back(awake[k]);
+      parked = true;
+    }
+
+  if(parked)
+    std::erase_if(awake, [&](std::uint32_t entity_id) { return world.entities[entity_id].sleeping || world.entities[entity_id].frozen; });
 }
 
-void update_physics(World& world, float dt)
+void wake_entities(World& world, glm::ivec3 position)
 {
-  for(Entity& entity : world.entities)
-    entity_update_physics(world, entity, dt);
+  AABB aabb = {
+    .position  = glm::vec3(position) - glm::vec3(CONTACT_EPSILON),
+    .dimension = glm::vec3(1.0f + 2.0f * CONTACT_EPSILON),
+  };
+
+  world.entity_hash.query(aabb, [&](std::uint32_t entity_id) {
+    entity_wake(world, entity_id);
+  });
+}
+
+void query_entities(const World& world, glm::vec3 center, float radius, std::vector<size_t>& entity_ids)
+{
+  AABB aabb = {
+    .position  = center - glm::vec3(radius),
+    .dimension = glm::vec3(2.0f * radius),
+  };
+
+  entity_ids.clear();
+  world.entity_hash.query(aabb, [&](std::uint32_t entity_id) {
+    if(entity_id >= world.entities.size())
+      return;
+
+    AABB      entity_aabb = entity_get_aabb(world.entities[entity_id]);
+    glm::vec3 closest     = glm::clamp(center, entity_aabb.position, entity_aabb.position + entity_aabb.dimension);
+    if(glm::distance(center, closest) <= radius)
+      entity_ids.push_back(entity_id);
+  });
 }
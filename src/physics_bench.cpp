@@ -0,0 +1,213 @@
+#include <world.hpp>
+
+#include <coordinates.hpp>
+#include <physics.hpp>
+#include <world_generator.hpp>
+#include <light_manager.hpp>
+
+#include <fmt/format.h>
+
+#include <omp.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static constexpr float FIXED_DT = 1.0f / 20.0f;
+
+static constexpr float WALK_STRENGTH = 2.0f;
+
+static int usage(const char *program)
+{
+  fmt::print(stderr, "Usage: {} [--entities N]... [--ticks N] [--size N] [--idle] [--player] [--world PATH]\n", program);
+  return -1;
+}
+
+static bool parse_int(const char *s, int& value)
+{
+  try { value = std::stoi(s); } catch(const std::logic_error&) { return false; }
+  return true;
+}
+
+// Checksum over the exact bits of the state of every entity, which must be the
+// same no matter how many threads physics runs on
+static std::uint64_t checksum(const World& world)
+{
+  std::uint64_t hash = 0xcbf29ce484222325;
+  auto combine = [&](glm::vec3 value) {
+    std::uint32_t bits[3];
+    std::memcpy(bits, &value, sizeof bits);
+    for(std::uint32_t bit : bits)
+    {
+      hash ^= bit;
+      hash *= 0x100000001b3;
+    }
+  };
+
+  for(const Entity& entity : world.entities)
+  {
+    combine(entity.transform.position);
+    combine(entity.velocity);
+  }
+  return hash;
+}
+
+struct Result
+{
+  float         milliseconds; // Per tick
+  std::uint64_t checksum;
+  size_t        sleeping;
+};
+
+// Drop entities at random on top of the terrain in the area, each of which then
+// keeps walking in its own direction unless idle. With a player, the player
+// comes first and stands still in the middle of the area.
+static Result run(World& world, int size, size_t entity_count, int ticks, bool idle, bool player, int threads)
+{
+  std::mt19937 prng(entity_count);
+  std::uniform_int_distribution<int>    position_distribution(-size / 2 * CHUNK_WIDTH, (size - size / 2) * CHUNK_WIDTH - 1);
+  std::uniform_real_distribution<float> angle_distribution(0.0f, 2.0f * M_PI);
+
+  world.entities.clear();
+  world.players.clear();
+  world.entity_hash.clear();
+  world.awake_entities.clear();
+  world.frozen_entities.clear();
+  world.physics_ticks = 0;
+  if(player)
+    world.players.push_back(Player{ .entity_id = 0 });
+
+  std::vector<glm::vec3> walks;
+  for(size_t i=0; i<entity_count + world.players.size(); ++i)
+  {
+    glm::ivec3 position = i < world.players.size() ? glm::ivec3(0) : glm::ivec3(position_distribution(prng), position_distribution(prng), 0);
+    auto [local_position, chunk_index] = coordinates::split(position);
+    position.z = world.chunks.at(chunk_index).sky_heights[local_position.y][local_position.x];
+
+    world.entities.push_back(Entity{
+      .id = 0,
+      .transform = {
+        .position = glm::vec3(position) + glm::vec3(0.5f, 0.5f, 0.0f),
+        .rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+      },
+      .velocity  = glm::vec3(0.0f, 0.0f, 0.0f),
+      .dimension = glm::vec3(0.9f, 0.9f, 1.9f),
+      .eye       = 1.5f,
+    });
+
+    float angle = angle_distribution(prng);
+    walks.push_back(i < world.players.size() ? glm::vec3(0.0f) : WALK_STRENGTH * glm::vec3(std::cos(angle), std::sin(angle), 0.0f));
+  }
+
+  omp_set_num_threads(threads);
+
+  using clock = std::chrono::steady_clock;
+  auto begin = clock::now();
+  for(int tick=0; tick<ticks; ++tick)
+  {
+    if(!idle)
+      for(size_t i=0; i<world.entities.size(); ++i)
+        entity_apply_force(world, i, walks[i], FIXED_DT);
+
+    update_physics(world, FIXED_DT);
+  }
+  auto end = clock::now();
+
+  size_t sleeping = 0;
+  for(const Entity& entity : world.entities)
+    if(entity.sleeping)
+      ++sleeping;
+
+  return Result{
+    .milliseconds = std::chrono::duration<float, std::milli>(end - begin).count() / ticks,
+    .checksum     = checksum(world),
+    .sleeping     = sleeping,
+  };
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<size_t> entity_counts;
+  int                 ticks  = 100;
+  int                 size   = 16;
+  bool                idle   = false;
+  bool                player = false;
+  std::string         path   = "world";
+  for(int i=1; i<argc; ++i)
+  {
+    std::string_view arg = argv[i];
+    if(arg == "--entities" && i+1 < argc)
+    {
+      int entity_count;
+      if(!parse_int(argv[++i], entity_count) || entity_count <= 0)
+        return usage(argv[0]);
+
+      entity_counts.push_back(entity_count);
+    }
+    else if(arg == "--ticks" && i+1 < argc)
+    {
+      if(!parse_int(argv[++i], ticks))
+        return usage(argv[0]);
+    }
+    else if(arg == "--size" && i+1 < argc)
+    {
+      if(!parse_int(argv[++i], size))
+        return usage(argv[0]);
+    }
+    else if(arg == "--idle")
+      idle = true;
+    else if(arg == "--player")
+      player = true;
+    else if(arg == "--world" && i+1 < argc)
+      path = argv[++i];
+    else
+      return usage(argv[0]);
+  }
+
+  if(entity_counts.empty())
+    entity_counts = { 1000, 10000, 100000 };
+
+  if(ticks <= 0 || size <= 0)
+    return usage(argv[0]);
+
+  // There are no players, so nothing is loaded other than what we ask for
+  World          world;
+  WorldGenerator world_generator(load_world_generation_config(path));
+  LightManager   light_manager;
+
+  std::vector<glm::ivec2> chunk_indices;
+  for(int y=0; y<size; ++y)
+    for(int x=0; x<size; ++x)
+      chunk_indices.push_back(glm::ivec2(x - size / 2, y - size / 2));
+
+  while(world.chunks.size() < chunk_indices.size())
+  {
+    world_generator.wait();
+    world_generator.update(world, light_manager, chunk_indices);
+    light_manager.update(world);
+  }
+
+  int threads = omp_get_max_threads();
+  fmt::print("threads      = {}\n", threads);
+  fmt::print("chunks       = {}\n", world.chunks.size());
+  fmt::print("ticks        = {}\n", ticks);
+  fmt::print("entities     = {}\n", idle ? "idle" : "walking");
+  fmt::print("players      = {}\n", player ? 1 : 0);
+  fmt::print("\n");
+  fmt::print("{:>10} {:>16} {:>16} {:>8} {:>10} {:>6}\n", "entities", "serial ms/tick", "parallel ms/tick", "speedup", "sleeping", "match");
+
+  bool matches = true;
+  for(size_t entity_count : entity_counts)
+  {
+    Result serial   = run(world, size, entity_count, ticks, idle, player, 1);
+    Result parallel = run(world, size, entity_count, ticks, idle, player, threads);
+    matches = matches && serial.checksum == parallel.checksum;
+
+    fmt::print("{:>10} {:>16.3f} {:>16.3f} {:>7.2f}x {:>10} {:>6}\n", entity_count, serial.milliseconds, parallel.milliseconds, serial.milliseconds / parallel.milliseconds, parallel.sleeping, serial.checksum == parallel.checksum ? "yes" : "NO");
+  }
+  return matches ? 0 : 1;
+}
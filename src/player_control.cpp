@@ -1,6 +1,7 @@
 #include <player_control.hpp>
 
 #include <directions.hpp>
+#include <physics.hpp>
 #include <ray_cast.hpp>
 
 static constexpr float ROTATION_SPEED = 0.1f;
@@ -32,7 +33,7 @@ void update_player_control(World& world, LightManager& light_manager, float dt)
       if(player_entity.grounded)
       {
         player_entity.grounded = false;
-        entity_apply_impulse(player_entity, JUMP_STRENGTH * glm::vec3(0.0f, 0.0f, 1.0f));
+        entity_apply_impulse(world, player.entity_id, JUMP_STRENGTH * glm::vec3(0.0f, 0.0f, 1.0f));
       }
 
     // 2: Movement
@@ -43,9 +44,9 @@ void update_player_control(World& world, LightManager& light_manager, float dt)
     if(player.key_s) translation -= player_entity.transform.local_forward();
 
     if(glm::vec3 direction = translation; direction.z = 0.0f, glm::length(direction) != 0.0f)
-      entity_apply_force(player_entity, MOVEMENT_SPEED * glm::normalize(direction), dt);
+      entity_apply_force(world, player.entity_id, MOVEMENT_SPEED * glm::normalize(direction), dt);
     else if(glm::vec3 direction = -player_entity.velocity; direction.z = 0.0f, glm::length(direction) != 0.0f)
-      entity_apply_force(player_entity, MOVEMENT_SPEED * glm::normalize(direction), dt, glm::length(direction));
+      entity_apply_force(world, player.entity_id, MOVEMENT_SPEED * glm::normalize(direction), dt, glm::length(direction));
 
     // 3: Rotation
     player_entity.transform = player_entity.transform.rotate(glm::vec3(0.0f,
@@ -84,7 +85,10 @@ void update_player_control(World& world, LightManager& light_manager, float dt)
               if(block->destroy_level != 15)
                 ++block->destroy_level;
               else
+              {
                 block->id = BLOCK_ID_NONE;
+                wake_entities(world, *selection);
+              }
 
               invalidate_mesh(world, *selection);
               light_manager.invalidate(*selection);
@@ -104,6 +108,7 @@ void update_player_control(World& world, LightManager& light_manager, float dt)
               if(!aabb_collide(player_entity.transform.position, player_entity.dimension, *placement, glm::vec3(1.0f, 1.0f, 1.0f))) // Cannot place a block that collide with the player
               {
                 block->id = BLOCK_ID_STONE;
+                wake_entities(world, *placement);
                 invalidate_mesh(world, *placement);
                 light_manager.invalidate(*placement);
                 for(glm::ivec3 direction : DIRECTIONS)
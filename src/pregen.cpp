@@ -0,0 +1,233 @@
+#include <world.hpp>
+
+#include <world_generator.hpp>
+#include <light_manager.hpp>
+#include <chunk_storage.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <fmt/format.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+static int usage(const char *program)
+{
+  fmt::print(stderr, "Usage: {} (--radius R [--center X Y] | --rect X0 Y0 X1 Y1) [--world PATH]\n", program);
+  return -1;
+}
+
+static bool parse_int(const char *s, int& value)
+{
+  try { value = std::stoi(s); } catch(const std::logic_error&) { return false; }
+  return true;
+}
+
+// Light spreads at most 14 blocks in from a chunk that is not loaded, which
+// is less than a chunk across, so only the 8 chunks around a chunk can leave
+// its light wrong by being missing
+static constexpr glm::ivec2 NEIGHBOURS[] = {
+  {-1, -1}, {0, -1}, {1, -1},
+  {-1,  0},          {1,  0},
+  {-1,  1}, {0,  1}, {1,  1},
+};
+
+// Pregenerate every chunk in an area and store it in the world directory.
+//
+// A chunk is only lit correctly once all 8 chunks around it are loaded and
+// light has settled, so a chunk is saved as soon as that is the case, and
+// dropped from memory again once no unsaved chunk around it is left. Chunks are generated row by row,
+// so only a few rows are ever in memory at once. Chunks already on disk are
+// skipped, so an interrupted run simply picks up where it left off.
+int main(int argc, char *argv[])
+{
+  std::string path = "world";
+
+  std::optional<int> radius;
+  glm::ivec2         center = glm::ivec2(0, 0);
+  glm::ivec2         from, to;
+  bool               rect = false;
+  for(int i=1; i<argc; ++i)
+  {
+    std::string_view arg = argv[i];
+    if(arg == "--radius" && i+1 < argc)
+    {
+      int value;
+      if(!parse_int(argv[++i], value) || value < 0)
+        return usage(argv[0]);
+
+      radius = value;
+    }
+    else if(arg == "--center" && i+2 < argc)
+    {
+      if(!parse_int(argv[++i], center.x) || !parse_int(argv[++i], center.y))
+        return usage(argv[0]);
+    }
+    else if(arg == "--rect" && i+4 < argc)
+    {
+      rect = true;
+      if(!parse_int(argv[++i], from.x) || !parse_int(argv[++i], from.y) || !parse_int(argv[++i], to.x) || !parse_int(argv[++i], to.y))
+        return usage(argv[0]);
+
+      if(from.x > to.x || from.y > to.y)
+        return usage(argv[0]);
+    }
+    else if(arg == "--world" && i+1 < argc)
+      path = argv[++i];
+    else
+      return usage(argv[0]);
+  }
+
+  if(rect == radius.has_value())
+    return usage(argv[0]);
+
+  // 1: Work out what to generate
+  std::vector<glm::ivec2> area;
+  if(rect)
+  {
+    for(int y = from.y; y <= to.y; ++y)
+      for(int x = from.x; x <= to.x; ++x)
+        area.push_back(glm::ivec2(x, y));
+  }
+  else
+  {
+    for(int dy = -*radius; dy <= *radius; ++dy)
+      for(int dx = -*radius; dx <= *radius; ++dx)
+        if(dx * dx + dy * dy <= *radius * *radius)
+          area.push_back(center + glm::ivec2(dx, dy));
+  }
+
+  std::unordered_set<glm::ivec2> in_area(area.begin(), area.end());
+  std::unordered_set<glm::ivec2> saved;
+  for(glm::ivec2 chunk_index : area)
+    if(chunk_exists(path, chunk_index))
+      saved.insert(chunk_index);
+
+  if(saved.size() == area.size())
+  {
+    spdlog::info("All {} chunks are already generated", area.size());
+    return 0;
+  }
+
+  if(!saved.empty())
+    spdlog::info("Resuming with {} of {} chunks already generated", saved.size(), area.size());
+
+  World          world;
+  WorldGenerator world_generator(load_world_generation_config(path));
+  LightManager   light_manager;
+
+  // Every unsaved chunk needs itself and all 8 chunks around it. Those that
+  // are already on disk are read back rather than generated again.
+  std::vector<glm::ivec2>        pending;
+  std::unordered_set<glm::ivec2> needed;
+  for(glm::ivec2 chunk_index : area)
+    if(!saved.contains(chunk_index))
+    {
+      needed.insert(chunk_index);
+      for(glm::ivec2 offset : NEIGHBOURS)
+        needed.insert(chunk_index + offset);
+    }
+
+  for(glm::ivec2 chunk_index : area)
+    for(int dy = -1; dy <= 1; ++dy)
+      for(int dx = -1; dx <= 1; ++dx)
+      {
+        glm::ivec2 neighbour_chunk_index = chunk_index + glm::ivec2(dx, dy);
+        if(!needed.erase(neighbour_chunk_index))
+          continue;
+
+        if(saved.contains(neighbour_chunk_index))
+        {
+          Chunk& chunk = world.chunks[neighbour_chunk_index];
+          if(!load_chunk(path, neighbour_chunk_index, chunk))
+          {
+            spdlog::error("Failed to load chunk {}", chunk_path(path, neighbour_chunk_index));
+            return -1;
+          }
+        }
+        else
+          pending.push_back(neighbour_chunk_index);
+      }
+
+  // 2: Generate
+  using clock = std::chrono::steady_clock;
+
+  size_t total         = area.size() - saved.size();
+  size_t done          = 0;
+  auto   begin         = clock::now();
+  auto   last_progress = begin;
+
+  std::vector<glm::ivec2> ready;
+  std::vector<glm::ivec2> unneeded;
+  while(done != total)
+  {
+    world_generator.update(world, light_manager, pending);
+    light_manager.update(world);
+
+    std::erase_if(pending, [&](glm::ivec2 chunk_index) { return world.chunks.contains(chunk_index); });
+
+    // 2.1: Save chunks that have all 8 chunks around them loaded, once light
+    //      has settled everywhere
+    ready.clear();
+    if(light_manager.pending() == 0)
+      for(const auto& [chunk_index, chunk] : world.chunks)
+      {
+        if(!in_area.contains(chunk_index) || saved.contains(chunk_index))
+          continue;
+
+        bool complete = true;
+        for(glm::ivec2 offset : NEIGHBOURS)
+          if(!world.chunks.contains(chunk_index + offset))
+            complete = false;
+
+        if(complete)
+          ready.push_back(chunk_index);
+      }
+
+    for(glm::ivec2 chunk_index : ready)
+    {
+      save_chunk(path, chunk_index, world.chunks.at(chunk_index));
+      saved.insert(chunk_index);
+      ++done;
+    }
+
+    // 2.2: Drop chunks that no unsaved chunk depends on any more
+    unneeded.clear();
+    for(const auto& [chunk_index, chunk] : world.chunks)
+    {
+      if(in_area.contains(chunk_index) && !saved.contains(chunk_index))
+        continue;
+
+      bool needed = false;
+      for(glm::ivec2 offset : NEIGHBOURS)
+        if(in_area.contains(chunk_index + offset) && !saved.contains(chunk_index + offset))
+          needed = true;
+
+      if(!needed)
+        unneeded.push_back(chunk_index);
+    }
+
+    for(glm::ivec2 chunk_index : unneeded)
+      world.chunks.erase(chunk_index);
+
+    // 2.3: Progress
+    auto now = clock::now();
+    if(now - last_progress >= std::chrono::seconds(1) || done == total)
+    {
+      last_progress = now;
+
+      float elapsed = std::chrono::duration<float>(now - begin).count();
+      float rate    = done / elapsed;
+      spdlog::info("{}/{} chunks ({:.1f}%), {:.1f} chunks/s, {} in memory, eta {:.0f} s",
+          done, total, 100.0f * done / total, rate, world.chunks.size(), rate > 0.0f ? (total - done) / rate : 0.0f);
+    }
+
+    // 2.4: Nothing else to do until more chunks are generated
+    if(done != total)
+      world_generator.wait();
+  }
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include <spatial_hash.hpp>
+
+#include <algorithm>
+
+#include <assert.h>
+
+void SpatialHash::clear()
+{
+  m_aabbs.clear();
+  m_cells.clear();
+}
+
+void SpatialHash::insert(const AABB& aabb)
+{
+  m_aabbs.push_back(aabb);
+  link(m_aabbs.size() - 1);
+}
+
+void SpatialHash::update(std::uint32_t index, const AABB& aabb)
+{
+  AABB& old_aabb = m_aabbs.at(index);
+
+  // Boxes mostly stay within the same cells from one update to the next
+  if(cell_min(aabb) == cell_min(old_aabb) && cell_max(aabb) == cell_max(old_aabb))
+  {
+    old_aabb = aabb;
+    return;
+  }
+
+  unlink(index);
+  old_aabb = aabb;
+  link(index);
+}
+
+void SpatialHash::link(std::uint32_t index)
+{
+  glm::ivec3 min = cell_min(m_aabbs[index]);
+  glm::ivec3 max = cell_max(m_aabbs[index]);
+  for(int z = min.z; z <= max.z; ++z)
+    for(int y = min.y; y <= max.y; ++y)
+      for(int x = min.x; x <= max.x; ++x)
+        m_cells[glm::ivec3(x, y, z)].push_back(index);
+}
+
+void SpatialHash::unlink(std::uint32_t index)
+{
+  glm::ivec3 min = cell_min(m_aabbs[index]);
+  glm::ivec3 max = cell_max(m_aabbs[index]);
+  for(int z = min.z; z <= max.z; ++z)
+    for(int y = min.y; y <= max.y; ++y)
+      for(int x = min.x; x <= max.x; ++x)
+      {
+        auto it = m_cells.find(glm::ivec3(x, y, z));
+        assert(it != m_cells.end());
+
+        std::vector<std::uint32_t>& indices = it->second;
+        auto index_it = std::find(indices.begin(), indices.end(), index);
+        assert(index_it != indices.end());
+
+        *index_it = indices.back();
+        indices.pop_back();
+        if(indices.empty())
+          m_cells.erase(it);
+      }
+}
@@ -27,19 +27,31 @@ AABB entity_get_aabb(const Entity& entity)
   };
 }
 
-void entity_apply_impulse(Entity& entity, glm::vec3 force)
+void entity_apply_impulse(World& world, size_t entity_id, glm::vec3 force)
 {
-  entity.velocity += force;
+  world.entities.at(entity_id).velocity += force;
+  entity_wake(world, entity_id);
 }
 
-void entity_apply_force(Entity& entity, glm::vec3 force, float dt)
+void entity_apply_force(World& world, size_t entity_id, glm::vec3 force, float dt)
 {
-  entity_apply_impulse(entity, dt * force);
+  entity_apply_impulse(world, entity_id, dt * force);
 }
 
-void entity_apply_force(Entity& entity, glm::vec3 force, float dt, float max)
+void entity_apply_force(World& world, size_t entity_id, glm::vec3 force, float dt, float max)
 {
-  entity_apply_impulse(entity, clamp(dt * force, max));
+  entity_apply_impulse(world, entity_id, clamp(dt * force, max));
+}
+
+void entity_wake(World& world, size_t entity_id)
+{
+  Entity& entity = world.entities.at(entity_id);
+  entity.rest_time = 0.0f;
+  if(entity.sleeping)
+  {
+    entity.sleeping = false;
+    world.awake_entities.push_back(entity_id);
+  }
 }
 
 /******************
@@ -83,6 +95,43 @@ const Block* get_block(const World& world, glm::ivec3 position)
   return ::get_block(it->second, local_position);
 }
 
+/*******
+ * Sky *
+ *******/
+void compute_sky_heights(Chunk& chunk)
+{
+  for(int y=0; y<CHUNK_WIDTH; ++y)
+    for(int x=0; x<CHUNK_WIDTH; ++x)
+    {
+      int z = CHUNK_HEIGHT;
+      while(z > 0 && chunk.blocks[z-1][y][x].id == BLOCK_ID_NONE)
+        --z;
+
+      chunk.sky_heights[y][x] = z;
+    }
+}
+
+/*********
+ * Chunk *
+ *********/
+bool is_meshable(const World& world, glm::ivec2 chunk_index)
+{
+  auto it = world.chunks.find(chunk_index);
+  if(it == world.chunks.end() || it->second.state != ChunkState::LIT)
+    return false;
+
+  // Neighbours that are not loaded count as settled, which is what lets chunks
+  // on the edge of the loaded area be meshed at all
+  const glm::ivec2 directions[] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+  for(glm::ivec2 direction : directions)
+  {
+    auto neighbour_it = world.chunks.find(chunk_index + direction);
+    if(neighbour_it != world.chunks.end() && neighbour_it->second.state != ChunkState::LIT)
+      return false;
+  }
+  return true;
+}
+
 /**************************
  * Invalidate them ALL!!! *
  **************************/
@@ -1,15 +1,21 @@
 #include <world_generator.hpp>
 
+#include <chunk_storage.hpp>
 #include <coordinates.hpp>
 #include <noise.hpp>
 
-#include <GLFW/glfw3.h>
-
 #include <spdlog/spdlog.h>
 #include <yaml-cpp/yaml.h>
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
 WorldGenerationConfig load_world_generation_config(std::string_view path)
 {
@@ -21,20 +27,41 @@ WorldGenerationConfig load_world_generation_config(std::string_view path)
   YAML::Node seed = generation["seed"];
   config.seed = seed.as<std::size_t>();
 
+  // Worlds created before noise was versioned do not specify it and must keep
+  // generating with the legacy noise.
+  YAML::Node noise_version = generation["noise_version"];
+  config.noise_version = static_cast<NoiseVersion>(noise_version ? noise_version.as<unsigned>() : static_cast<unsigned>(NoiseVersion::LEGACY));
+  if(config.noise_version != NoiseVersion::LEGACY && config.noise_version != NoiseVersion::HASHED)
+    throw std::runtime_error(fmt::format("Unsupported noise version {}", static_cast<unsigned>(config.noise_version)));
+
   YAML::Node terrain = generation["terrain"];
 
+  if(YAML::Node density = terrain["density"])
+  {
+    DensityGenerationConfig density_generation_config;
+
+    density_generation_config.block_id         = density["block_id"].as<std::uint32_t>();
+    density_generation_config.surface_block_id = density_generation_config.block_id;
+    density_generation_config.surface_depth    = 0;
+    if(YAML::Node surface = density["surface"])
+    {
+      density_generation_config.surface_block_id = surface["block_id"].as<std::uint32_t>();
+      density_generation_config.surface_depth    = surface["depth"].as<unsigned>();
+    }
+
+    density_generation_config.function = DensityFunction::compile(density["function"], config.seed, config.noise_version);
+
+    config.terrain.density = std::move(density_generation_config);
+  }
+
   for(YAML::Node layer : terrain["layers"])
   {
     LayerGenerationConfig layer_generation_config;
 
     layer_generation_config.block_id = layer["block_id"].as<std::uint32_t>();
 
-    layer_generation_config.height_base              = layer["height_base"]                .as<float>();
-    layer_generation_config.height_noise.frequency   = layer["height_noise"]["frequency"]  .as<float>();
-    layer_generation_config.height_noise.amplitude   = layer["height_noise"]["amplitude"]  .as<float>();
-    layer_generation_config.height_noise.lacunarity  = layer["height_noise"]["lacunarity"] .as<float>();
-    layer_generation_config.height_noise.persistence = layer["height_noise"]["persistence"].as<float>();
-    layer_generation_config.height_noise.octaves     = layer["height_noise"]["octaves"]    .as<unsigned>();
+    layer_generation_config.height_base  = layer["height_base"].as<float>();
+    layer_generation_config.height_noise = load_noise_config(layer["height_noise"], config.noise_version);
 
     config.terrain.layers.push_back(layer_generation_config);
   }
@@ -47,22 +74,30 @@ WorldGenerationConfig load_world_generation_config(std::string_view path)
   config.caves.min_height    = caves["min_height"]        .as<float>();
   config.caves.max_height    = caves["max_height"]        .as<float>();
 
-  config.caves.dig_noise.frequency   = caves["dig_noise"]["frequency"]     .as<float>();
-  config.caves.dig_noise.amplitude   = caves["dig_noise"]["amplitude"]     .as<float>();
-  config.caves.dig_noise.lacunarity  = caves["dig_noise"]["lacunarity"]    .as<float>();
-  config.caves.dig_noise.persistence = caves["dig_noise"]["persistence"]   .as<float>();
-  config.caves.dig_noise.octaves     = caves["dig_noise"]["octaves"]       .as<unsigned>();
-
-  config.caves.radius_base              = caves["radius_base"]                .as<float>();
-  config.caves.radius_noise.frequency   = caves["radius_noise"]["frequency"]  .as<float>();
-  config.caves.radius_noise.amplitude   = caves["radius_noise"]["amplitude"]  .as<float>();
-  config.caves.radius_noise.lacunarity  = caves["radius_noise"]["lacunarity"] .as<float>();
-  config.caves.radius_noise.persistence = caves["radius_noise"]["persistence"].as<float>();
-  config.caves.radius_noise.octaves     = caves["radius_noise"]["octaves"]    .as<unsigned>();
+  config.caves.dig_noise    = load_noise_config(caves["dig_noise"], config.noise_version);
+  config.caves.radius_base  = caves["radius_base"].as<float>();
+  config.caves.radius_noise = load_noise_config(caves["radius_noise"], config.noise_version);
 
   return config;
 }
 
+// Attributes the time between consecutive laps to statistics counters
+class Stopwatch
+{
+public:
+  Stopwatch() : m_begin(std::chrono::steady_clock::now()) {}
+
+  void lap(std::atomic<std::uint64_t>& counter)
+  {
+    auto end = std::chrono::steady_clock::now();
+    counter.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_begin).count(), std::memory_order_relaxed);
+    m_begin = end;
+  }
+
+private:
+  std::chrono::steady_clock::time_point m_begin;
+};
+
 template <class T>
 static inline size_t hash_combine(std::size_t seed, const T& v)
 {
@@ -70,40 +105,137 @@ static inline size_t hash_combine(std::size_t seed, const T& v)
   return seed ^ (hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2));
 }
 
-WorldGenerator::WorldGenerator(WorldGenerationConfig config) : m_config(std::move(config)) {}
+WorldGenerator::WorldGenerator(WorldGenerationConfig config, std::optional<std::string> world_path) :
+  m_config(std::move(config)),
+  m_world_path(std::move(world_path)),
+  m_max_jobs(MAX_JOBS_PER_THREAD * std::max(std::thread::hardware_concurrency(), 1u))
+{}
 
 void WorldGenerator::update(World& world, LightManager& light_manager)
 {
-  const Player& player        = world.players.front();
-  const Entity& player_entity = world.entities.at(player.entity_id);
-  glm::ivec2 center = {
-    std::floor(player_entity.transform.position.x / CHUNK_WIDTH),
-    std::floor(player_entity.transform.position.y / CHUNK_WIDTH),
-  };
-  try_load(world, light_manager, center, CHUNK_LOAD_RADIUS);
+  update(world, light_manager, collect_requests(world));
 }
 
-void WorldGenerator::try_load(World& world, LightManager& light_manager, glm::ivec2 chunk_index, int radius)
+void WorldGenerator::update(World& world, LightManager& light_manager, std::span<const glm::ivec2> chunk_indices)
 {
-  for(int dy = -radius; dy <= radius; ++dy)
-    for(int dx = -radius; dx <= radius; ++dx)
-      if(dx * dx + dy * dy <= radius * radius)
-      {
-        glm::ivec2 position = chunk_index + glm::ivec2(dx, dy);
-        try_load(world, light_manager, position);
-      }
+  // 1: Splice in everything that has finished generating
+  Stopwatch stopwatch;
+  for(auto it = m_generated_chunks.begin(); it != m_generated_chunks.end();)
+    if(GeneratedChunk *generated_chunk = it->second.try_get())
+    {
+      if(generated_chunk->node)
+        splice(world, light_manager, it->first, *generated_chunk);
+      else
+        m_unreadable_chunks.insert(it->first);
+      it = m_generated_chunks.erase(it);
+    }
+    else
+      ++it;
+  stopwatch.lap(m_statistics.splice);
+
+  std::erase_if(m_chunk_infos_in_flight, [this](glm::ivec2 chunk_index) {
+    return m_chunk_infos.at(chunk_index).info.try_get() != nullptr;
+  });
+
+  ++m_update_count;
+
+  // 2: Submit jobs for missing chunks, most important first, for as long as
+  //    there are free slots. Anything that does not make it is reconsidered
+  //    next update with fresh priorities, and simply dropped if it is out of
+  //    range by then.
+  for(glm::ivec2 chunk_index : chunk_indices)
+  {
+    if(world.chunks.contains(chunk_index) || m_generated_chunks.contains(chunk_index))
+      continue;
+
+    if(!try_submit(chunk_index))
+      break;
+  }
+
+  // 3: Keep the chunk info cache bounded
+  evict_chunk_infos(world.players.size());
 }
 
-void WorldGenerator::try_load(World& world, LightManager& light_manager, glm::ivec2 chunk_index)
+std::vector<glm::ivec2> WorldGenerator::collect_requests(const World& world) const
 {
-  if(world.chunks.find(chunk_index) != world.chunks.end())
-    return;
+  const int radius = CHUNK_LOAD_RADIUS;
+
+  std::unordered_map<glm::ivec2, float> priorities;
+  for(const Player& player : world.players)
+  {
+    const Entity& player_entity = world.entities.at(player.entity_id);
+    glm::ivec2 center = {
+      std::floor(player_entity.transform.position.x / CHUNK_WIDTH),
+      std::floor(player_entity.transform.position.y / CHUNK_WIDTH),
+    };
+    glm::vec2 forward = glm::vec2(player_entity.transform.gocal_forward());
+    if(glm::length2(forward) != 0.0f)
+      forward = glm::normalize(forward);
+
+    for(int dy = -radius; dy <= radius; ++dy)
+      for(int dx = -radius; dx <= radius; ++dx)
+        if(dx * dx + dy * dy <= radius * radius)
+        {
+          glm::ivec2 chunk_index = center + glm::ivec2(dx, dy);
+          if(world.chunks.contains(chunk_index) || m_generated_chunks.contains(chunk_index))
+            continue;
+
+          // Chunks behind the player count as up to twice as far away
+          float distance = glm::length(glm::vec2(dx, dy));
+          float facing   = distance != 0.0f ? glm::dot(glm::vec2(dx, dy) / distance, forward) : 1.0f;
+          float priority = distance * (1.0f + VIEW_WEIGHT * (1.0f - facing) * 0.5f);
+
+          auto [it, inserted] = priorities.emplace(chunk_index, priority);
+          if(!inserted)
+            it->second = std::min(it->second, priority);
+        }
+  }
+
+  std::vector<Request> requests;
+  for(auto [chunk_index, priority] : priorities)
+    requests.push_back(Request{ .chunk_index = chunk_index, .priority = priority });
+
+  std::sort(requests.begin(), requests.end(), [](const Request& lhs, const Request& rhs) {
+    return std::tie(lhs.priority, lhs.chunk_index.x, lhs.chunk_index.y) < std::tie(rhs.priority, rhs.chunk_index.x, rhs.chunk_index.y);
+  });
 
-  // 0: Setup
-  int radius = std::ceil(m_config.caves.max_segment * m_config.caves.step / CHUNK_WIDTH);
+  std::vector<glm::ivec2> chunk_indices;
+  for(const Request& request : requests)
+    chunk_indices.push_back(request.chunk_index);
+  return chunk_indices;
+}
+
+void WorldGenerator::wait()
+{
+  // The thread pool runs jobs in order, so the oldest one is the first to be
+  // done, give or take
+  if(!m_chunk_infos_in_flight.empty())
+    m_chunk_infos.at(m_chunk_infos_in_flight.front()).info.get();
+  else if(!m_generated_chunks.empty())
+    m_generated_chunks.begin()->second.get();
+}
+
+bool WorldGenerator::try_submit(glm::ivec2 chunk_index)
+{
+  auto jobs = [this]() { return m_chunk_infos_in_flight.size() + m_generated_chunks.size(); };
+
+  // 0: Read back the chunk if it is stored, which needs no chunk infos
+  if(m_world_path && !m_unreadable_chunks.contains(chunk_index) && chunk_exists(*m_world_path, chunk_index))
+  {
+    if(jobs() >= m_max_jobs)
+      return false;
+
+    m_generated_chunks.emplace(chunk_index, [world_path=*m_world_path, chunk_index]() {
+      return load_stored_chunk(world_path, chunk_index);
+    });
+    return true;
+  }
+
+  // 1: Make sure every chunk info around the chunk is available
+  int radius = chunk_info_radius();
 
-  // 1: Check if we can generate the chunk now
   bool can_load = true;
+  std::vector<const ChunkInfo*> chunk_infos;
   for(int y = chunk_index.y - radius; y <= chunk_index.y + radius; ++y)
     for(int x = chunk_index.x - radius; x <= chunk_index.x + radius; ++x)
     {
@@ -111,88 +243,451 @@ void WorldGenerator::try_load(World& world, LightManager& light_manager, glm::iv
       auto it = m_chunk_infos.find(neighbour_chunk_index);
       if(it == m_chunk_infos.end())
       {
+        if(jobs() >= m_max_jobs)
+          return false;
+
         bool success;
-        std::tie(it, success) = m_chunk_infos.emplace(neighbour_chunk_index, [this, neighbour_chunk_index]() {
+        std::tie(it, success) = m_chunk_infos.try_emplace(neighbour_chunk_index, [this, neighbour_chunk_index]() {
           std::mt19937 prng_global(m_config.seed);
           std::mt19937 prng_local(hash_combine(m_config.seed, neighbour_chunk_index));
-          return generate_chunk_info(prng_global, prng_local, m_config, neighbour_chunk_index);
+          return generate_chunk_info(prng_global, prng_local, m_config, neighbour_chunk_index, m_statistics);
         });
         assert(success);
+        m_chunk_infos_in_flight.push_back(neighbour_chunk_index);
       }
 
-      if(!it->second.try_get())
+      it->second.last_used = m_update_count;
+      if(const ChunkInfo *chunk_info = it->second.info.try_get())
+        chunk_infos.push_back(chunk_info);
+      else
         can_load = false;
     }
 
   if(!can_load)
+    return true;
+
+  if(jobs() >= m_max_jobs)
+    return false;
+
+  // 2: Generate the chunk on the thread pool. Chunk infos are not evicted
+  //    while a chunk around them is being generated, so it is fine to hand out
+  //    pointers to them.
+  m_generated_chunks.emplace(chunk_index, [this, chunk_index, radius, chunk_infos=std::move(chunk_infos)]() {
+    return generate_chunk(m_config, chunk_index, radius, chunk_infos, m_statistics);
+  });
+  return true;
+}
+
+int WorldGenerator::chunk_info_radius() const
+{
+  return std::ceil(m_config.caves.max_segment * m_config.caves.step / CHUNK_WIDTH);
+}
+
+void WorldGenerator::evict_chunk_infos(size_t player_count)
+{
+  int    radius          = chunk_info_radius();
+  size_t max_chunk_infos = CHUNK_INFOS_PER_PLAYER * std::max<size_t>(player_count, 1) + m_generated_chunks.size() * (2 * radius + 1) * (2 * radius + 1);
+  if(m_chunk_infos.size() <= max_chunk_infos)
     return;
 
-  // 2: Chunk Generation
-  auto [it, success] = world.chunks.try_emplace(chunk_index);
-  assert(success);
-  Chunk& chunk = it->second;
+  // Chunk infos still being computed, referenced by a chunk being generated or
+  // used during this update must stay, as they are about to be needed again.
+  // Everything else can be evicted, least recently used first, and will simply
+  // be computed again if it is ever needed.
+  std::unordered_set<glm::ivec2> in_use;
+  for(const auto& [chunk_index, generated_chunk] : m_generated_chunks)
+    for(int y = chunk_index.y - radius; y <= chunk_index.y + radius; ++y)
+      for(int x = chunk_index.x - radius; x <= chunk_index.x + radius; ++x)
+        in_use.insert(glm::ivec2(x, y));
+
+  std::vector<std::pair<std::uint64_t, glm::ivec2>> candidates;
+  for(auto& [chunk_index, cached_chunk_info] : m_chunk_infos)
+    if(cached_chunk_info.info.try_get() && cached_chunk_info.last_used != m_update_count && !in_use.contains(chunk_index))
+      candidates.emplace_back(cached_chunk_info.last_used, chunk_index);
+
+  std::sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) {
+    return std::tie(lhs.first, lhs.second.x, lhs.second.y) < std::tie(rhs.first, rhs.second.x, rhs.second.y);
+  });
+
+  for(const auto& [last_used, chunk_index] : candidates)
+  {
+    if(m_chunk_infos.size() <= max_chunk_infos)
+      break;
+    m_chunk_infos.erase(chunk_index);
+  }
+}
+
+void WorldGenerator::splice(World& world, LightManager& light_manager, glm::ivec2 chunk_index, GeneratedChunk& generated_chunk)
+{
+  auto result = world.chunks.insert(std::move(generated_chunk.node));
+  assert(result.inserted);
+
+  light_manager.invalidate(chunk_index);
+  for(glm::ivec3 position : generated_chunk.invalidations)
+    light_manager.invalidate(position);
+
+  // Neighbouring chunks were meshed with their faces towards the missing chunk
+  // showing, and blocks of theirs facing it were lit as if it were fully bright
+  const glm::ivec2 directions[] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+  for(glm::ivec2 direction : directions)
+  {
+    auto neighbour_it = world.chunks.find(chunk_index + direction);
+    if(neighbour_it == world.chunks.end())
+      continue;
+
+    Chunk& neighbour_chunk = neighbour_it->second;
+    invalidate_mesh(neighbour_chunk);
+    for(int z=0; z<CHUNK_HEIGHT; ++z)
+      for(int i=0; i<CHUNK_WIDTH; ++i)
+      {
+        glm::ivec3 position;
+        position.x = direction.x == 0 ? i : direction.x < 0 ? CHUNK_WIDTH - 1 : 0;
+        position.y = direction.y == 0 ? i : direction.y < 0 ? CHUNK_WIDTH - 1 : 0;
+        position.z = z;
+
+        const Block& block = neighbour_chunk.blocks[position.z][position.y][position.x];
+        if(block.id == BLOCK_ID_NONE && !block.sky)
+          light_manager.invalidate(coordinates::local_to_global(position, chunk_index + direction));
+      }
+  }
+}
+
+// Compute light within a single chunk, as if it were surrounded by darkness.
+//
+// Air with nothing but air above it is lit directly by the sky, and light then
+// floods from there into the rest of the air, one level dimmer per block.
+//
+// Sky light can only spread sideways, into columns whose sky starts higher up,
+// so only the stretch of each column next to such a column seeds the flood
+// fill. Everything else lit by the sky is surrounded by blocks that are either
+// just as bright or solid.
+static void generate_light(Chunk& chunk)
+{
+  std::vector<std::uint32_t> queue;
+
+  // 1: Sky light
+  compute_sky_heights(chunk);
+  for(int y=0; y<CHUNK_WIDTH; ++y)
+    for(int x=0; x<CHUNK_WIDTH; ++x)
+      for(int z=0; z<CHUNK_HEIGHT; ++z)
+      {
+        bool sky = z >= chunk.sky_heights[y][x];
+
+        Block& block = chunk.blocks[z][y][x];
+        block.sky         = sky;
+        block.light_level = sky ? 15 : 0;
+      }
+
+  for(int y=0; y<CHUNK_WIDTH; ++y)
+    for(int x=0; x<CHUNK_WIDTH; ++x)
+    {
+      int sky_height = chunk.sky_heights[y][x];
+      int seed_end   = sky_height;
+      if(x > 0)               seed_end = std::max<int>(seed_end, chunk.sky_heights[y][x-1]);
+      if(x < CHUNK_WIDTH - 1) seed_end = std::max<int>(seed_end, chunk.sky_heights[y][x+1]);
+      if(y > 0)               seed_end = std::max<int>(seed_end, chunk.sky_heights[y-1][x]);
+      if(y < CHUNK_WIDTH - 1) seed_end = std::max<int>(seed_end, chunk.sky_heights[y+1][x]);
+
+      for(int z=sky_height; z<seed_end; ++z)
+        queue.push_back((z * CHUNK_WIDTH + y) * CHUNK_WIDTH + x);
+    }
+
+  // 2: Flood fill. Every source starts at the same level, so a block is final
+  //    the first time it is reached.
+  for(size_t i=0; i<queue.size(); ++i)
+  {
+    int x = queue[i] % CHUNK_WIDTH;
+    int y = queue[i] / CHUNK_WIDTH % CHUNK_WIDTH;
+    int z = queue[i] / CHUNK_WIDTH / CHUNK_WIDTH;
+
+    unsigned light_level = chunk.blocks[z][y][x].light_level;
+    if(light_level <= 1)
+      continue;
 
-  const ChunkInfo& chunk_info = m_chunk_infos.at(chunk_index).get();
+    auto spread = [&](int x, int y, int z) {
+      if(x < 0 || x >= CHUNK_WIDTH || y < 0 || y >= CHUNK_WIDTH || z < 0 || z >= CHUNK_HEIGHT)
+        return;
+
+      Block& block = chunk.blocks[z][y][x];
+      if(block.id == BLOCK_ID_NONE && block.light_level < light_level - 1)
+      {
+        block.light_level = light_level - 1;
+        queue.push_back((z * CHUNK_WIDTH + y) * CHUNK_WIDTH + x);
+      }
+    };
+    spread(x - 1, y, z);
+    spread(x + 1, y, z);
+    spread(x, y - 1, z);
+    spread(x, y + 1, z);
+    spread(x, y, z - 1);
+    spread(x, y, z + 1);
+  }
+}
+
+// Layers are stacked on top of each other, each as thick as its height map.
+//
+// Layer boundaries are computed once per column. Blocks are stored with z
+// outermost, so rather than writing each column, every horizontal slice
+// that lies entirely within one layer or entirely above the terrain is
+// filled as one contiguous run, and only the few slices crossing a layer
+// boundary are written block by block.
+void WorldGenerator::generate_layered_terrain(Chunk& chunk, const ChunkInfo& chunk_info, const TerrainGenerationConfig& config)
+{
+  const size_t layer_count = chunk_info.height_maps.size();
+
+  Block air = {};
+  air.id          = BLOCK_ID_NONE;
+  air.light_level = 15;
+  air.sky         = true;
+
+  std::vector<Block> layer_blocks(layer_count);
+  for(size_t i=0; i<layer_count; ++i)
+  {
+    layer_blocks[i].id          = config.layers[i].block_id;
+    layer_blocks[i].light_level = 0;
+    layer_blocks[i].sky         = false;
+  }
+
+  // The block at height z in a column belongs to the first layer i with
+  // z < boundaries[i][column], or is air if there is none.
+  std::vector<std::array<int, CHUNK_WIDTH * CHUNK_WIDTH>> boundaries(layer_count);
+  std::vector<int> min_boundaries(layer_count, CHUNK_HEIGHT);
+  std::vector<int> max_boundaries(layer_count, 0);
+  for(int y=0; y<CHUNK_WIDTH; ++y)
+    for(int x=0; x<CHUNK_WIDTH; ++x)
+    {
+      float height = 0.0f;
+      for(size_t i=0; i<layer_count; ++i)
+      {
+        height += chunk_info.height_maps[i].heights[y][x];
+
+        int boundary = std::clamp<float>(std::ceil(height), 0, CHUNK_HEIGHT);
+        boundaries[i][y * CHUNK_WIDTH + x] = boundary;
+        min_boundaries[i] = std::min(min_boundaries[i], boundary);
+        max_boundaries[i] = std::max(max_boundaries[i], boundary);
+      }
+    }
+
+  for(int z=0; z<CHUNK_HEIGHT; ++z)
+  {
+    Block *slice = &chunk.blocks[z][0][0];
+
+    // Every column is already past the layers below this one
+    size_t layer = 0;
+    while(layer < layer_count && z >= max_boundaries[layer])
+      ++layer;
+
+    if(layer == layer_count)
+      std::fill(slice, slice + CHUNK_WIDTH * CHUNK_WIDTH, air);
+    else if(z < min_boundaries[layer])
+      std::fill(slice, slice + CHUNK_WIDTH * CHUNK_WIDTH, layer_blocks[layer]);
+    else
+      for(int column=0; column<CHUNK_WIDTH * CHUNK_WIDTH; ++column)
+      {
+        size_t i = layer;
+        while(i < layer_count && z >= boundaries[i][column])
+          ++i;
+        slice[column] = i != layer_count ? layer_blocks[i] : air;
+      }
+  }
+}
+
+// The density function is only sampled on a coarse grid, every few blocks,
+// and trilinearly interpolated in between. Terrain features are much larger
+// than the grid, and this cuts the number of noise evaluations per chunk by
+// more than two orders of magnitude.
+void WorldGenerator::generate_density_terrain(Chunk& chunk, glm::ivec2 chunk_index, const DensityGenerationConfig& config)
+{
+  constexpr int STEP_XY = 4;
+  constexpr int STEP_Z  = 8;
+  static_assert(CHUNK_WIDTH  % STEP_XY == 0);
+  static_assert(CHUNK_HEIGHT % STEP_Z  == 0);
+
+  const glm::uvec3 size = glm::uvec3(CHUNK_WIDTH / STEP_XY + 1, CHUNK_WIDTH / STEP_XY + 1, CHUNK_HEIGHT / STEP_Z + 1);
+
+  std::vector<float> samples(size.x * size.y * size.z);
+  config.function.evaluate(coordinates::local_to_global(glm::vec3(0.0f), chunk_index), glm::vec3(STEP_XY, STEP_XY, STEP_Z), size, samples.data());
+  auto sample = [&](unsigned x, unsigned y, unsigned z) { return samples[(z * size.y + y) * size.x + x]; };
+
+  Block air = {};
+  air.id          = BLOCK_ID_NONE;
+  air.light_level = 15;
+  air.sky         = true;
+
+  Block solid = {};
+  solid.id          = config.block_id;
+  solid.light_level = 0;
+  solid.sky         = false;
 
-  // 2.1: Create terrain based on height maps
   for(int z=0; z<CHUNK_HEIGHT; ++z)
+  {
+    const unsigned cz = z / STEP_Z;
+    const float    tz = float(z % STEP_Z) / STEP_Z;
     for(int y=0; y<CHUNK_WIDTH; ++y)
+    {
+      const unsigned cy = y / STEP_XY;
+      const float    ty = float(y % STEP_XY) / STEP_XY;
       for(int x=0; x<CHUNK_WIDTH; ++x)
       {
-        Block *block = get_block(chunk, glm::ivec3(x, y, z));
-        if(!block) [[unlikely]]
-          continue;
+        const unsigned cx = x / STEP_XY;
+        const float    tx = float(x % STEP_XY) / STEP_XY;
 
-        float height = 0.0f;
-        for(size_t i=0; i<chunk_info.height_maps.size(); ++i)
-        {
-          const HeightMap& height_map = chunk_info.height_maps[i];
+        float c00 = std::lerp(sample(cx, cy,   cz),   sample(cx+1, cy,   cz),   tx);
+        float c10 = std::lerp(sample(cx, cy+1, cz),   sample(cx+1, cy+1, cz),   tx);
+        float c01 = std::lerp(sample(cx, cy,   cz+1), sample(cx+1, cy,   cz+1), tx);
+        float c11 = std::lerp(sample(cx, cy+1, cz+1), sample(cx+1, cy+1, cz+1), tx);
+        float density = std::lerp(std::lerp(c00, c10, ty), std::lerp(c01, c11, ty), tz);
+
+        chunk.blocks[z][y][x] = density > 0.0f ? solid : air;
+      }
+    }
+  }
 
-          height += height_map.heights[y][x];
-          if(z < height)
+  // Cover every stretch of ground exposed to the air above with the surface
+  // block, which also covers the ground beneath overhangs.
+  if(config.surface_block_id != config.block_id && config.surface_depth != 0)
+    for(int y=0; y<CHUNK_WIDTH; ++y)
+      for(int x=0; x<CHUNK_WIDTH; ++x)
+      {
+        unsigned depth = config.surface_depth;
+        for(int z=CHUNK_HEIGHT-1; z>=0; --z)
+        {
+          Block& block = chunk.blocks[z][y][x];
+          if(block.id == BLOCK_ID_NONE)
+            depth = 0;
+          else if(depth < config.surface_depth)
           {
-            block->id          = m_config.terrain.layers[i].block_id;
-            block->light_level = 0;
-            block->sky         = false;
-            goto done;
+            block.id = config.surface_block_id;
+            ++depth;
           }
         }
-
-        block->id          = BLOCK_ID_NONE;
-        block->light_level = 15;
-        block->sky         = true;
-done:;
       }
+}
 
-  // 2.2: Carve out caves based off worms
-  for(int y = chunk_index.y - radius; y <= chunk_index.y + radius; ++y)
-    for(int x = chunk_index.x - radius; x <= chunk_index.x + radius; ++x)
+// Light is stored along with the blocks, and was settled with all neighbours
+// in place, so there is nothing on the border to invalidate. A chunk that
+// fails to load comes back without a node.
+WorldGenerator::GeneratedChunk WorldGenerator::load_stored_chunk(const std::string& world_path, glm::ivec2 chunk_index)
+{
+  GeneratedChunk generated_chunk;
+
+  std::unordered_map<glm::ivec2, Chunk> chunks;
+  if(!load_chunk(world_path, chunk_index, chunks[chunk_index]))
+  {
+    spdlog::warn("Failed to load chunk {}, generating it instead", chunk_path(world_path, chunk_index));
+    return generated_chunk;
+  }
+
+  generated_chunk.node = chunks.extract(chunk_index);
+  return generated_chunk;
+}
+
+WorldGenerator::GeneratedChunk WorldGenerator::generate_chunk(const WorldGenerationConfig& config, glm::ivec2 chunk_index, int radius, const std::vector<const ChunkInfo*>& chunk_infos, Statistics& statistics)
+{
+  statistics.chunk_count.fetch_add(1, std::memory_order_relaxed);
+
+  Stopwatch stopwatch;
+  GeneratedChunk generated_chunk;
+
+  // Build the chunk inside a map of its own so that it can later be moved into
+  // the world as a node without copying any blocks.
+  std::unordered_map<glm::ivec2, Chunk> chunks;
+  Chunk& chunk = chunks[chunk_index];
+
+  // 1: Create terrain
+  if(config.terrain.density)
+    generate_density_terrain(chunk, chunk_index, *config.terrain.density);
+  else
+    generate_layered_terrain(chunk, *chunk_infos[(2 * radius + 1) * radius + radius], config.terrain);
+
+  stopwatch.lap(statistics.fill);
+
+  // 2: Carve out caves based off worms
+  //
+  //    Only nodes binned into this chunk can touch it. Each sphere is carved one
+  //    row at a time, with the ends of each row found through the same test a
+  //    per-block loop would use, so that exactly the same blocks are carved.
+  Block cave = {};
+  cave.id          = BLOCK_ID_NONE;
+  cave.light_level = 0;
+  cave.sky         = false;
+
+  for(const ChunkInfo *neighbour_chunk_info : chunk_infos)
+  {
+    auto it = neighbour_chunk_info->worm_nodes.find(chunk_index);
+    if(it == neighbour_chunk_info->worm_nodes.end())
+      continue;
+
+    for(const Worm::Node& node : it->second)
     {
-      glm::ivec2       neighbour_chunk_index = glm::ivec2(x, y);
-      const ChunkInfo& neighbour_chunk_info  = m_chunk_infos.at(neighbour_chunk_index).get();
-      for(const Worm& worm : neighbour_chunk_info.worms)
-        for(const Worm::Node& node : worm.nodes)
+      glm::vec3 center = coordinates::global_to_local(node.center, chunk_index);
+      float     radius = node.radius;
+
+      int z_begin = std::max<int>(center.z - radius, 0);
+      int z_end   = std::min<int>(std::floor(center.z + radius), CHUNK_HEIGHT - 1);
+      int y_begin = std::max<int>(center.y - radius, 0);
+      int y_end   = std::min<int>(std::floor(center.y + radius), CHUNK_WIDTH - 1);
+      for(int z = z_begin; z <= z_end; ++z)
+        for(int y = y_begin; y <= y_end; ++y)
         {
-          glm::vec3  center  = coordinates::global_to_local(node.center, chunk_index);
-          float      radius  = node.radius;
-          for(int z = center.z - radius; z<=center.z+radius; ++z)
-            for(int y = center.y - radius; y<=center.y+radius; ++y)
-              for(int x = center.x - radius; x<=center.x+radius; ++x)
-              {
-                glm::ivec3 position(x, y, z);
-                if(glm::length2(glm::vec3(position) - center) < radius * radius)
-                  if(Block* block = get_block(chunk, position))
-                  {
-                    block->id          = BLOCK_ID_NONE;
-                    block->light_level = 0;
-                    block->sky         = false;
-                    light_manager.invalidate(coordinates::local_to_global(position, chunk_index));
-                  }
-              }
+          auto inside = [&](int x) { return glm::length2(glm::vec3(x, y, z) - center) < radius * radius; };
+
+          // The block closest to the center is inside if any block in this row is
+          int middle = std::round(center.x);
+          if(!inside(middle))
+            continue;
+
+          float dy   = y - center.y;
+          float dz   = z - center.z;
+          float half = std::sqrt(std::max(radius * radius - dy * dy - dz * dz, 0.0f));
+
+          int x_begin = std::min<int>(std::ceil(center.x - half), middle);
+          int x_end   = std::max<int>(std::floor(center.x + half), middle);
+          while(!inside(x_begin))    ++x_begin;
+          while(inside(x_begin - 1)) --x_begin;
+          while(!inside(x_end))      --x_end;
+          while(inside(x_end + 1))   ++x_end;
+
+          x_begin = std::max(x_begin, 0);
+          x_end   = std::min(x_end, CHUNK_WIDTH - 1);
+          if(x_begin > x_end)
+            continue;
+
+          Block *row = &chunk.blocks[z][y][0];
+          std::fill(row + x_begin, row + x_end + 1, cave);
         }
     }
+  }
+
+  stopwatch.lap(statistics.carve);
+
+  // 3: Light the chunk on its own, and leave it to the light manager to settle
+  //    light across its borders once it is in the world. Only air below the
+  //    sky in border columns can depend on neighbouring chunks.
+  generate_light(chunk);
+
+  std::vector<glm::ivec2> border_columns;
+  for(int y=0; y<CHUNK_WIDTH; ++y)
+    for(int x=0; x<CHUNK_WIDTH; ++x)
+      if(x == 0 || x == CHUNK_WIDTH - 1 || y == 0 || y == CHUNK_WIDTH - 1)
+        border_columns.push_back(glm::ivec2(x, y));
+
+  int max_sky_height = 0;
+  for(glm::ivec2 column : border_columns)
+    max_sky_height = std::max<int>(max_sky_height, chunk.sky_heights[column.y][column.x]);
 
+  for(int z=0; z<max_sky_height; ++z)
+    for(glm::ivec2 column : border_columns)
+      if(z < chunk.sky_heights[column.y][column.x] && chunk.blocks[z][column.y][column.x].id == BLOCK_ID_NONE)
+        generated_chunk.invalidations.push_back(coordinates::local_to_global(glm::ivec3(column.x, column.y, z), chunk_index));
+
+  stopwatch.lap(statistics.light);
+
+  chunk.state            = ChunkState::GENERATED;
   chunk.mesh_invalidated = true;
+
+  generated_chunk.node = chunks.extract(chunk_index);
+  return generated_chunk;
 }
 
 template<typename Prng>
@@ -204,9 +699,10 @@ std::vector<WorldGenerator::HeightMap> WorldGenerator::generate_height_maps(Prng
     size_t seed = prng();
 
     HeightMap height_map;
+    noise_grid(seed, coordinates::local_to_global(glm::vec2(0, 0), chunk_index), glm::vec2(1.0f), glm::uvec2(CHUNK_WIDTH), terrain_layer_config.height_noise, &height_map.heights[0][0]);
     for(int y=0; y<CHUNK_WIDTH; ++y)
       for(int x=0; x<CHUNK_WIDTH; ++x)
-        height_map.heights[y][x] = std::max(terrain_layer_config.height_base + noise(seed, coordinates::local_to_global(glm::vec2(x, y), chunk_index), terrain_layer_config.height_noise), 0.0f);
+        height_map.heights[y][x] = std::max(terrain_layer_config.height_base + height_map.heights[y][x], 0.0f);
     height_maps.push_back(height_map);
   }
   return height_maps;
@@ -260,13 +756,35 @@ std::vector<WorldGenerator::Worm> WorldGenerator::generate_worms(Prng& prng, con
 }
 
 template<typename Prng>
-WorldGenerator::ChunkInfo WorldGenerator::generate_chunk_info(Prng& prng_global, Prng& prng_local, const WorldGenerationConfig& config, glm::ivec2 chunk_index)
+WorldGenerator::ChunkInfo WorldGenerator::generate_chunk_info(Prng& prng_global, Prng& prng_local, const WorldGenerationConfig& config, glm::ivec2 chunk_index, Statistics& statistics)
 {
-  std::vector<HeightMap> height_maps = generate_height_maps(prng_global, config.terrain, chunk_index);
+  statistics.chunk_info_count.fetch_add(1, std::memory_order_relaxed);
+
+  // Height maps are only of use to layered terrain, which density terrain
+  // replaces altogether
+  Stopwatch stopwatch;
+  std::vector<HeightMap> height_maps = config.terrain.density ? std::vector<HeightMap>{} : generate_height_maps(prng_global, config.terrain, chunk_index);
+  stopwatch.lap(statistics.height_maps);
   std::vector<Worm>      worms       = generate_worms(prng_local, config.caves, chunk_index);
+
+  // Bin every node into all chunks its sphere may overlap. The extra block of
+  // padding absorbs any rounding in the bounds.
+  std::unordered_map<glm::ivec2, std::vector<Worm::Node>> worm_nodes;
+  for(const Worm& worm : worms)
+    for(const Worm::Node& node : worm.nodes)
+    {
+      glm::ivec2 min = glm::floor((glm::vec2(node.center) - (node.radius + 1.0f)) / static_cast<float>(CHUNK_WIDTH));
+      glm::ivec2 max = glm::floor((glm::vec2(node.center) + (node.radius + 1.0f)) / static_cast<float>(CHUNK_WIDTH));
+      for(int y = min.y; y <= max.y; ++y)
+        for(int x = min.x; x <= max.x; ++x)
+          worm_nodes[glm::ivec2(x, y)].push_back(node);
+    }
+
+  stopwatch.lap(statistics.worms);
+
   return ChunkInfo {
     .height_maps = std::move(height_maps),
-    .worms       = std::move(worms),
+    .worm_nodes  = std::move(worm_nodes),
   };
 }
 
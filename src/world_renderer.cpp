@@ -3,8 +3,39 @@
 #include <coordinates.hpp>
 #include <directions.hpp>
 
+#include <graphics/profiler.hpp>
+
 #include <GLFW/glfw3.h>
 
+// Test an axis-aligned box against the view frustum of the given
+// view-projection matrix, using planes extracted as described in "Fast
+// Extraction of Viewing Frustum Planes from the World-View-Projection Matrix"
+// by Gil Gribb and Klaus Hartmann.
+static bool frustum_cull(const glm::mat4& view_projection, glm::vec3 min, glm::vec3 max)
+{
+  glm::vec4 rows[4];
+  for(int i=0; i<4; ++i)
+    rows[i] = glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+
+  const glm::vec4 planes[] = {
+    rows[3] + rows[0], rows[3] - rows[0],
+    rows[3] + rows[1], rows[3] - rows[1],
+    rows[3] + rows[2], rows[3] - rows[2],
+  };
+
+  for(const glm::vec4& plane : planes)
+  {
+    glm::vec3 positive = glm::vec3(
+      plane.x >= 0.0f ? max.x : min.x,
+      plane.y >= 0.0f ? max.y : min.y,
+      plane.z >= 0.0f ? max.z : min.z
+    );
+    if(glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+      return true;
+  }
+  return false;
+}
+
 WorldRenderer::WorldRenderer(ResourcePack resource_pack) : m_resource_pack(std::move(resource_pack))
 {
   m_chunk_shader_program = std::make_unique<graphics::ShaderProgram>("assets/chunk.vert", "assets/chunk.frag");
@@ -13,7 +44,12 @@ WorldRenderer::WorldRenderer(ResourcePack resource_pack) : m_resource_pack(std::
 
 void WorldRenderer::render(const graphics::Camera& camera, const World& world, bool third_person, graphics::WireframeRenderer& wireframe_renderer)
 {
+  graphics::Profiler& profiler = graphics::Profiler::instance();
+
+  profiler.begin(graphics::Pass::CHUNK);
   render_chunks(camera, world);
+  profiler.end(graphics::Pass::CHUNK);
+
   render_entites(camera, world, third_person, wireframe_renderer);
 }
 
@@ -33,7 +69,7 @@ void WorldRenderer::render_chunks(const graphics::Camera& camera, const World& w
   std::vector<Vertex>   vertices;
 
   for(auto& [chunk_index, chunk] : world.chunks)
-    if(chunk.mesh_invalidated)
+    if(chunk.mesh_invalidated && is_meshable(world, chunk_index))
     {
       chunk.mesh_invalidated = false;
 
@@ -125,14 +161,29 @@ void WorldRenderer::render_chunks(const graphics::Camera& camera, const World& w
   glBindTexture(GL_TEXTURE_2D_ARRAY, m_resource_pack.blocks_texture_array->id());
   m_chunk_shader_program->set_uniform( "blocksTextureArray", 0);
 
+  graphics::RenderCounters& counters = graphics::Profiler::instance().counters();
   for(const auto& [chunk_index, mesh] : m_chunk_meshes)
+  {
+    glm::vec3 min = glm::vec3(coordinates::local_to_global(glm::ivec3(0, 0, 0), chunk_index));
+    glm::vec3 max = min + glm::vec3(CHUNK_WIDTH, CHUNK_WIDTH, CHUNK_HEIGHT);
+    if(frustum_cull(projection * view, min, max))
+    {
+      ++counters.chunks_culled;
+      continue;
+    }
+
+    ++counters.chunks_drawn;
     mesh->draw();
+  }
 }
 
 void WorldRenderer::render_entites(const graphics::Camera& camera, const World& world, bool third_person, graphics::WireframeRenderer& wireframe_renderer)
 {
   const Player& player = world.players.front();
 
+  graphics::Profiler& profiler = graphics::Profiler::instance();
+
+  profiler.begin(graphics::Pass::ENTITY);
   m_entity_shader_program->use();
   for(size_t i=0; i<world.entities.size(); ++i)
   {
@@ -154,7 +205,9 @@ void WorldRenderer::render_entites(const graphics::Camera& camera, const World&
     m_entity_shader_program->set_uniform("ourTexture", 0);
     entity_resource.mesh->draw();
   }
+  profiler.end(graphics::Pass::ENTITY);
 
+  profiler.begin(graphics::Pass::WIREFRAME);
   for(size_t i=0; i<world.entities.size(); ++i)
   {
     if(!third_person && i == player.entity_id)
@@ -165,5 +218,6 @@ void WorldRenderer::render_entites(const graphics::Camera& camera, const World&
     AABB entity_aabb = entity_get_aabb(entity);
     wireframe_renderer.render_cube(camera, entity_aabb.position, entity_aabb.dimension, glm::vec3(0.6f, 0.6f, 0.6f), 5.0f);
   }
+  profiler.end(graphics::Pass::WIREFRAME);
 }
 
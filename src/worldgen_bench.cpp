@@ -0,0 +1,200 @@
+#include <world.hpp>
+
+#include <world_generator.hpp>
+#include <light_manager.hpp>
+#include <noise.hpp>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+static int usage(const char *program)
+{
+  fmt::print(stderr, "Usage: {} [--size N] [--world PATH]\n", program);
+  return -1;
+}
+
+// Checksum of some value of every block in the given chunks, which must not
+// change between builds unless world generation is meant to change
+template<typename F>
+static std::uint64_t checksum(const World& world, const std::vector<glm::ivec2>& chunk_indices, F value)
+{
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for(glm::ivec2 chunk_index : chunk_indices)
+  {
+    const Chunk& chunk = world.chunks.at(chunk_index);
+    for(int z=0; z<CHUNK_HEIGHT; ++z)
+      for(int y=0; y<CHUNK_WIDTH; ++y)
+        for(int x=0; x<CHUNK_WIDTH; ++x)
+        {
+          hash ^= value(chunk.blocks[z][y][x]);
+          hash *= 0x100000001b3;
+        }
+  }
+  return hash;
+}
+
+// Largest difference between noise_grid() and noise() allowed, relative to the
+// largest value noise can reach
+static constexpr float NOISE_GRID_TOLERANCE = 1e-5f;
+
+// Largest relative difference between noise_grid() and noise() over random
+// grids of hashed noise, of all sizes and spacings
+static float noise_grid_error()
+{
+  std::mt19937 prng(0);
+  std::uniform_real_distribution<float> origin_distribution(-10000.0f, 10000.0f);
+  std::uniform_real_distribution<float> step_distribution(0.1f, 4.0f);
+  std::uniform_real_distribution<float> frequency_distribution(0.001f, 0.2f);
+  std::uniform_int_distribution<unsigned> size_distribution(1, 20);
+  std::uniform_int_distribution<unsigned> octaves_distribution(1, 6);
+
+  float error = 0.0f;
+  std::vector<float> values;
+  for(int n=0; n<200; ++n)
+  {
+    NoiseConfig config = {
+      .version     = NoiseVersion::HASHED,
+      .frequency   = frequency_distribution(prng),
+      .amplitude   = 1.0f,
+      .lacunarity  = 2.0f,
+      .persistence = 0.5f,
+      .octaves     = static_cast<float>(octaves_distribution(prng)),
+    };
+
+    float range = 0.0f;
+    for(unsigned i=0; i<config.octaves; ++i)
+      range += std::pow(config.persistence, static_cast<float>(i));
+
+    size_t     seed   = prng();
+    glm::vec3  origin = glm::vec3(origin_distribution(prng), origin_distribution(prng), origin_distribution(prng));
+    glm::vec3  step   = glm::vec3(step_distribution(prng), step_distribution(prng), step_distribution(prng));
+    glm::uvec3 size   = glm::uvec3(size_distribution(prng), size_distribution(prng), size_distribution(prng));
+
+    values.resize(size.x * size.y);
+    noise_grid(seed, glm::vec2(origin), glm::vec2(step), glm::uvec2(size), config, values.data());
+    for(unsigned y=0; y<size.y; ++y)
+      for(unsigned x=0; x<size.x; ++x)
+      {
+        glm::vec2 position = glm::vec2(origin) + glm::vec2(x, y) * glm::vec2(step);
+        error = std::max(error, std::abs(values[y * size.x + x] - noise(seed, position, config)) / range);
+      }
+
+    values.resize(size.x * size.y * size.z);
+    noise_grid(seed, origin, step, size, config, values.data());
+    for(unsigned z=0; z<size.z; ++z)
+      for(unsigned y=0; y<size.y; ++y)
+        for(unsigned x=0; x<size.x; ++x)
+        {
+          glm::vec3 position = origin + glm::vec3(x, y, z) * step;
+          error = std::max(error, std::abs(values[(z * size.y + y) * size.x + x] - noise(seed, position, config)) / range);
+        }
+  }
+  return error;
+}
+
+int main(int argc, char *argv[])
+{
+  int         size = 32;
+  std::string path = "world";
+  for(int i=1; i<argc; ++i)
+  {
+    std::string_view arg = argv[i];
+    if(arg == "--size" && i+1 < argc)
+    {
+      try { size = std::stoi(argv[++i]); } catch(const std::logic_error&) { return usage(argv[0]); }
+    }
+    else if(arg == "--world" && i+1 < argc)
+      path = argv[++i];
+    else
+      return usage(argv[0]);
+  }
+
+  if(size <= 0)
+    return usage(argv[0]);
+
+  // Batched noise must agree with noise() before anything generated with it
+  // means anything
+  float error = noise_grid_error();
+  if(error > NOISE_GRID_TOLERANCE)
+  {
+    fmt::print(stderr, "noise_grid() differs from noise() by {:.3g}, more than the tolerance of {:.3g}\n", error, NOISE_GRID_TOLERANCE);
+    return 1;
+  }
+
+  // There are no players, so nothing is loaded other than what we ask for
+  World          world;
+  WorldGenerator world_generator(load_world_generation_config(path));
+  LightManager   light_manager;
+
+  // Generate from the center outwards, as a player would see it
+  std::vector<glm::ivec2> chunk_indices;
+  for(int y=0; y<size; ++y)
+    for(int x=0; x<size; ++x)
+      chunk_indices.push_back(glm::ivec2(x - size / 2, y - size / 2));
+
+  std::vector<glm::ivec2> load_order = chunk_indices;
+  std::stable_sort(load_order.begin(), load_order.end(), [](glm::ivec2 lhs, glm::ivec2 rhs) {
+    return lhs.x * lhs.x + lhs.y * lhs.y < rhs.x * rhs.x + rhs.y * rhs.y;
+  });
+
+  using clock = std::chrono::steady_clock;
+
+  clock::duration light_time = {};
+  auto begin = clock::now();
+  while(world.chunks.size() < chunk_indices.size())
+  {
+    // Leave the CPU to the workers until there is something to splice in
+    world_generator.wait();
+    world_generator.update(world, light_manager, load_order);
+
+    auto light_begin = clock::now();
+    light_manager.update(world);
+    light_time += clock::now() - light_begin;
+  }
+  auto end = clock::now();
+
+  // Settled light only depends on which chunks are loaded, not on the order
+  // in which they arrived. Chunks on the edge of the area are also lit by the
+  // unloaded chunks beyond it, so only those inside are checked.
+  while(light_manager.pending() != 0)
+    light_manager.update(world);
+
+  std::vector<glm::ivec2> interior_chunk_indices;
+  for(int y=1; y<size-1; ++y)
+    for(int x=1; x<size-1; ++x)
+      interior_chunk_indices.push_back(glm::ivec2(x - size / 2, y - size / 2));
+
+  float seconds = std::chrono::duration<float>(end - begin).count();
+
+  const WorldGenerator::Statistics& statistics = world_generator.statistics();
+  auto print_phase = [&](std::string_view name, const std::atomic<std::uint64_t>& nanoseconds) {
+    fmt::print("{:<12} = {:10.3f} ms ({:.3f} ms per chunk)\n", name, nanoseconds.load() / 1e6, nanoseconds.load() / 1e6 / chunk_indices.size());
+  };
+
+  fmt::print("threads      = {}\n", std::thread::hardware_concurrency());
+  fmt::print("noise error  = {:.3g}\n", error);
+  fmt::print("chunks       = {}\n", statistics.chunk_count.load());
+  fmt::print("chunk infos  = {}\n", statistics.chunk_info_count.load());
+  fmt::print("time         = {:.3f} s\n", seconds);
+  fmt::print("throughput   = {:.1f} chunks/s\n", chunk_indices.size() / seconds);
+  fmt::print("\n");
+  fmt::print("Time spent in each phase, summed over all threads:\n");
+  print_phase("height maps", statistics.height_maps);
+  print_phase("worms",       statistics.worms);
+  print_phase("fill",        statistics.fill);
+  print_phase("carve",       statistics.carve);
+  print_phase("light",       statistics.light);
+  print_phase("splice",      statistics.splice);
+  fmt::print("{:<12} = {:10.3f} ms ({:.3f} ms per chunk)\n", "light settle", std::chrono::duration<double, std::milli>(light_time).count(), std::chrono::duration<double, std::milli>(light_time).count() / chunk_indices.size());
+  fmt::print("\n");
+  fmt::print("checksum     = {:016x} (light {:016x})\n",
+      checksum(world, chunk_indices,          [](Block block) { return block.id; }),
+      checksum(world, interior_chunk_indices, [](Block block) { return block.sky << 4 | block.light_level; }));
+  return 0;
+}